@@ -48,6 +48,7 @@
  * 
  */
 void (*_cbButtonPressed)(uint8_t);
+void (*_cbButtonActivity)(void);
 uint8_t _debounceTime;
 
 
@@ -57,12 +58,18 @@ void setButtonCallback(void (*callback)(uint8_t), uint8_t debounceTime) {
 }
 
 
+void setButtonActivityCallback(void (*callback)(void)) {
+    _cbButtonActivity = callback;
+}
 
 void buttonsCheck(uint8_t currentButtons) {
     static uint8_t lastButtons = 0;
     static uint8_t btnClearedCounter = 0;
 
     if (currentButtons > 0) {
+        if (lastButtons == 0 && _cbButtonActivity != NULL) {
+            (*_cbButtonActivity)();
+        }
         btnClearedCounter = 0;
         lastButtons |= currentButtons;
     }
@@ -35,6 +35,16 @@ typedef struct Button_t {
  */
 void setButtonCallback(void (*callback)(uint8_t), uint8_t debounceTime);
 
+/**
+ * @brief Set a callback which gets invoked as soon as any button goes down.
+ * 
+ * In contrast to the button callback this happens without de-bouncing
+ * and before the button got released. Useful to e.g. wake up a display.
+ * 
+ * @param callback which gets called when a button press starts
+ */
+void setButtonActivityCallback(void (*callback)(void));
+
 /**
  * @brief Set the up buttons IO
  * 
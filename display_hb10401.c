@@ -17,194 +17,437 @@
 
 #include <stdbool.h>
 #include <util/delay.h>
+#include <avr/pgmspace.h>
 
 #include "pt.h"
 
 
 struct lcd_print_state {
     struct pt pt;
-    uint16_t timer;
+    Timeout timeout;
 
-    bool repaint;
     uint8_t repaintPos; 
-    char videoBuffer[LCD_BUFFER_LEN];
+
+    // the controller init sequence is done
+    bool initialised;
+
+    // DDRAM address the controller would write the next data to, 0xFF if unknown
+    uint8_t cursor;
+
+    // one bit per cell which differs from what the controller shows
+    uint8_t dirty[(LCD_BUFFER_LEN + 7) / 8];
+    char videoBuffer[LCD_SCREENS][LCD_BUFFER_LEN];
+
+    // the screen which is shown on the display
+    uint8_t screen;
+
+    // user defined glyphs in PROGMEM, 8 bytes each
+    const uint8_t* pGlyphs;
+    uint8_t glyphCount;
+
+    // the glyph each CGRAM slot holds, 0xFF if empty
+    uint8_t slotGlyph[LCD_CGRAM_SLOTS];
+
+    // 0 for the most recently used slot, LCD_CGRAM_SLOTS-1 for the least recently used
+    uint8_t slotAge[LCD_CGRAM_SLOTS];
+
+    // one bit per slot which needs to be uploaded
+    uint8_t cgramDirty;
+    uint8_t cgramSlot;
+    uint8_t cgramRow;
+
+    // marquee via display shifting, one of LCD_MARQUEE_*
+    uint8_t marqueeState;
+    bool marqueeRestart;
+    uint8_t marqueeLine;     // the DDRAM line, 0 or 1
+    uint8_t marqueePos;
+    uint32_t marqueeLastStep; // tick of the last shift
+    uint16_t marqueeStepTicks;
+    char marqueeText[LCD_MARQUEE_LEN];
 };
 
+#define LCD_MARQUEE_OFF  0
+#define LCD_MARQUEE_LOAD 1 // the text needs to be written to the DDRAM
+#define LCD_MARQUEE_RUN  2
+#define LCD_MARQUEE_STOP 3 // the shift needs to be undone
+
 static struct lcd_print_state tsLcd = {0,};
 
+// DDRAM address of the first character of each row
+static const uint8_t lcdAddr[4] = {LCD_ADDR_LINE1, LCD_ADDR_LINE2, LCD_ADDR_LINE3, LCD_ADDR_LINE4};
 
 /**
- * @brief is did timer pass the given duration?
- * 
- * A single tic is about 2.5 uS. Should not be used for anything > 0x50
- * because of the overrun.
+ * @brief wait for the given milliseconds inside task_lcd without blocking
  * 
- * @param oldTimerVal 
- * @param duration 
- * @return bool true if time is not yet over
+ * Unlike the short waits this doesn't yield, so the scheduler only
+ * resumes the task on its period and can sleep meanwhile.
  */
-bool isAfter(uint16_t oldTimerVal, uint16_t duration) {
-    uint16_t tNow = TASK_TIMER.CNT;
-    uint16_t max = oldTimerVal + duration;
-    if (max >= TASK_TIMER_OVERFLOW) {
-        max = max - TASK_TIMER_OVERFLOW;
-        // 0xE3 + 0x20 -> 0x03 because overflow
-        return tNow > max && tNow < oldTimerVal;
-    } else {
-        // 0x83 + 0x20 -> 0xA3 no overflow
-        return tNow > max;
-    }
-}
+#define LCD_WAIT_MS(ms) \
+    timeout_start(&tsLcd.timeout, SYSTICK_MS(ms)); \
+    PT_WAIT_UNTIL(&tsLcd.pt, timeout_expired(&tsLcd.timeout));
+// END define
 
+/**
+ * @brief wait inside task_lcd until the controller took the last command
+ */
+#define LCD_WAIT_READY() \
+    timeout_start(&tsLcd.timeout, LCD_DISP_WAIT); \
+    PT_YIELD_UNTIL(&tsLcd.pt, lcd_ready());
+// END define
+
+
+#ifndef LCD_BUS_8BIT
+// the data port pattern of each nibble, however D4..D7 are wired
+#define LCD_NIBBLE(n) \
+    ((((n) & 0x01) ? LCD_D4 : 0) | (((n) & 0x02) ? LCD_D5 : 0) | \
+     (((n) & 0x04) ? LCD_D6 : 0) | (((n) & 0x08) ? LCD_D7 : 0))
+// END define
+
+static const uint8_t lcdNibble[16] = {
+    LCD_NIBBLE(0x0), LCD_NIBBLE(0x1), LCD_NIBBLE(0x2), LCD_NIBBLE(0x3),
+    LCD_NIBBLE(0x4), LCD_NIBBLE(0x5), LCD_NIBBLE(0x6), LCD_NIBBLE(0x7),
+    LCD_NIBBLE(0x8), LCD_NIBBLE(0x9), LCD_NIBBLE(0xA), LCD_NIBBLE(0xB),
+    LCD_NIBBLE(0xC), LCD_NIBBLE(0xD), LCD_NIBBLE(0xE), LCD_NIBBLE(0xF),
+};
+#endif
 
-void lcd_sendNibble(uint8_t upperNibble) {
-    uint8_t setBits = 0;
-    uint8_t clearBits = 0;
-    LCD_EN_PORT.OUTSET =LCD_EN;
+/**
+ * @brief latch the data which is already on the bus
+ */
+static inline void lcd_strobe(void) {
+    FIO_SET(LCD_EN_PORT, LCD_EN);
+    _delay_us(LCD_EN_PULSE_US);
+    FIO_CLR(LCD_EN_PORT, LCD_EN);
+    // the enable cycle time is 1000ns at 3V
+    _delay_us(LCD_EN_PULSE_US);
+}
 
-    if (upperNibble & 0x80) {
-        setBits |= LCD_D7;
-    }
-    else {
-        clearBits |= LCD_D7;
-    }
+void lcd_sendNibble(uint8_t upperNibble) {
+#ifdef LCD_BUS_8BIT
+    // during the reset the lower 4 bits must be 0 anyway
+    FIO_VPORT(LCD_DATA_PORT).OUT = upperNibble & 0xF0;
+#else
+    uint8_t pattern = lcdNibble[upperNibble >> 4];
+    LCD_DATA_PORT.OUTSET = pattern;
+    LCD_DATA_PORT.OUTCLR = LCD_DATA_MASK & ~pattern;
+#endif
+
+    lcd_strobe();
+}
 
-    if (upperNibble & 0x40) {
-        setBits |= LCD_D6;
-    }
-    else {
-        clearBits |= LCD_D6;
-    }
+/**
+ * @brief send a whole byte, RS must already be set
+ */
+static void lcd_sendByte(uint8_t data) {
+#ifdef LCD_BUS_8BIT
+    FIO_VPORT(LCD_DATA_PORT).OUT = data;
+    lcd_strobe();
+#else
+    lcd_sendNibble(data);
+    lcd_sendNibble(data << 4);
+#endif
+}
 
-    if (upperNibble & 0x20) {
-        setBits |= LCD_D5;
-    }
-    else {
-        clearBits |= LCD_D5;
-    }
 
-    if (upperNibble & 0x10) {
-        setBits |= LCD_D4;
-    }
-    else {
-        clearBits |= LCD_D4;
-    }
-    LCD_DATA_PORT.OUTSET = setBits;
-    LCD_DATA_PORT.OUTCLR = clearBits;
+#ifdef LCD_RW
+/**
+ * @brief read the busy flag of the controller
+ * 
+ * In 4-bit mode the busy flag is D7 of the first nibble,
+ * the second nibble holds the rest of the address counter and gets ignored.
+ */
+static bool lcd_busy(void) {
+    LCD_DATA_PORT.DIRCLR = LCD_DATA_MASK;
+    LCD_RS_PORT.OUTCLR = LCD_RS; //RS=0 and RW=1 means read busy flag
+    LCD_RW_PORT.OUTSET = LCD_RW;
+
+    LCD_EN_PORT.OUTSET = LCD_EN;
+    _delay_us(1);
+    bool busy = LCD_DATA_PORT.IN & LCD_D7;
+    LCD_EN_PORT.OUTCLR = LCD_EN;
 
+#ifndef LCD_BUS_8BIT
+    _delay_us(1);
+    LCD_EN_PORT.OUTSET = LCD_EN;
+    _delay_us(1);
     LCD_EN_PORT.OUTCLR = LCD_EN;
+#endif
+
+    LCD_RW_PORT.OUTCLR = LCD_RW;
+    LCD_DATA_PORT.DIRSET = LCD_DATA_MASK;
+
+    return busy;
 }
+#endif
 
+/**
+ * @brief whether the controller can take the next command
+ * 
+ * Never waits longer than the worst case LCD_DISP_WAIT, 
+ * but finishes earlier if the controller reports it is not busy anymore.
+ */
+static bool lcd_ready(void) {
+#ifdef LCD_RW
+    return timeout_expired(&tsLcd.timeout) || !lcd_busy();
+#else
+    return timeout_expired(&tsLcd.timeout);
+#endif
+}
 
 void lcd_command(uint8_t cmd) {
     LCD_RS_PORT.OUTCLR = LCD_RS; //RS=0 means instruction
 
-    lcd_sendNibble(cmd);
-    lcd_sendNibble(cmd << 4);
+    lcd_sendByte(cmd);
 }
 
 void lcd_data(uint8_t data) {
     LCD_RS_PORT.OUTSET = LCD_RS; //RS=1 means data
 
-    lcd_sendNibble(data);
-    lcd_sendNibble(data << 4);
+    lcd_sendByte(data);
 }
 
 /**
  * @brief set the cursor position to the given position on the screen
  * 
- * @param row 0-based row number from 0..3 
- * @param column 0based column number from 0..9
+ * @param row 0-based row number from 0..LCD_ROWS-1
+ * @param column 0based column number from 0..LCD_COLUMNS-1
  */
 void lcd_setPosition(uint8_t row, uint8_t column) {
     lcd_command(LCD_COMMAND_SET_DDRAM | (lcdAddr[row] + column));
 }
 
 void setup_lcd(void) {
-    // display needs some time to start working.
-    _delay_ms(20);
-  
     // clear pins
     LCD_RS_PORT.OUTCLR = LCD_RS;
     LCD_EN_PORT.OUTCLR = LCD_EN;
-    LCD_DATA_PORT.OUTCLR = LCD_D4 | LCD_D5 | LCD_D6 | LCD_D7;
+    LCD_DATA_PORT.OUTCLR = LCD_DATA_MASK;
 
     // EN, RS, RW and data pins as output
     LCD_RS_PORT.DIRSET = LCD_RS;
     LCD_EN_PORT.DIRSET = LCD_EN;
-    LCD_DATA_PORT.DIRSET = LCD_D4 | LCD_D5 | LCD_D6 | LCD_D7;
+#ifdef LCD_RW
+    LCD_RW_PORT.OUTCLR = LCD_RW;
+    LCD_RW_PORT.DIRSET = LCD_RW;
+#endif
+    LCD_DATA_PORT.DIRSET = LCD_DATA_MASK;
+
+    // clear the screen buffers, the CLEAR command blanks the controller as well
+    for (uint8_t screen=0; screen < LCD_SCREENS; screen++) {
+        for (int i=0; i < LCD_BUFFER_LEN; i++) {
+            tsLcd.videoBuffer[screen][i] = ' ';
+        }
+    }
+    tsLcd.screen = 0;
+    for (uint8_t i=0; i < sizeof(tsLcd.dirty); i++) {
+        tsLcd.dirty[i] = 0;
+    }
+    tsLcd.cursor = 0xFF;
 
-    // clear the screen buffer
-    for (int i=0; i < LCD_BUFFER_LEN; i++) {
-        tsLcd.videoBuffer[i] = ' ';
+    for (uint8_t i=0; i < LCD_CGRAM_SLOTS; i++) {
+        tsLcd.slotGlyph[i] = 0xFF;
+        tsLcd.slotAge[i] = i;
     }
+    tsLcd.cgramDirty = 0;
 
-    // magic reset
-    lcd_sendNibble(0x03); 
-    _delay_ms(6);
-    lcd_sendNibble(0x03); 
-    _delay_ms(1);
-    lcd_sendNibble(0x03); 
-    _delay_ms(1);
+    // the display itself gets initialised by task_lcd
+    tsLcd.initialised = false;
+    PT_INIT(&tsLcd.pt);
+}
 
+/**
+ * @brief redraw the whole screen from the video buffer
+ */
+void lcd_repaint(void) {
+    for (uint8_t i=0; i < sizeof(tsLcd.dirty); i++) {
+        tsLcd.dirty[i] = 0xFF;
+    }
+}
 
-    // enable 4 bit mode
-    LCD_RS_PORT.OUTCLR = LCD_RS; //RS=0 means instruction
+/**
+ * @brief set a single cell of a screen
+ * 
+ * The cell gets marked dirty if it changed on the shown screen.
+ */
+static void lcd_setScreenCell(uint8_t screen, uint8_t bufPos, char c) {
+    if (tsLcd.videoBuffer[screen][bufPos] != c) {
+        tsLcd.videoBuffer[screen][bufPos] = c;
+        if (screen == tsLcd.screen) {
+            tsLcd.dirty[bufPos >> 3] |= 1 << (bufPos & 0x07);
+        }
+    }
+}
 
-    // enable 4bit mode, this itself is a 8-bit command
-    lcd_sendNibble(LCD_COMMAND_4BIT); 
-    _delay_us(50);
+static inline void lcd_setCell(uint8_t bufPos, char c) {
+    lcd_setScreenCell(tsLcd.screen, bufPos, c);
+}
 
-    // and now swittch to 2line with 5x8 mode
-    lcd_command(LCD_COMMAND_FNSET | 0x08);
-    _delay_us(37);
+void lcd_selectScreen(uint8_t screen) {
+    if (screen >= LCD_SCREENS || screen == tsLcd.screen) {
+        return;
+    }
 
-    lcd_command(LCD_COMMAND_DISPONOFF | 0x04); // display on, but no cursor nor blinking    
-    _delay_us(37);
-    
-    lcd_command(LCD_COMMAND_CLEAR);
-    _delay_ms(50);
+    // only the cells which differ need to be sent, pending cells stay dirty
+    for (uint8_t i=0; i < LCD_BUFFER_LEN; i++) {
+        if (tsLcd.videoBuffer[screen][i] != tsLcd.videoBuffer[tsLcd.screen][i]) {
+            tsLcd.dirty[i >> 3] |= 1 << (i & 0x07);
+        }
+    }
+    tsLcd.screen = screen;
+}
 
-    lcd_command(LCD_COMMAND_SET_DDRAM | LCD_ADDR_LINE1);
-    _delay_us(37);
+uint8_t lcd_getScreen(void) {
+    return tsLcd.screen;
+}
 
-    lcd_setPosition(0,0);
-    _delay_us(37);
-    //X lcd_command(LCD_COMMAND_ENTRYMODE | 0x02);
+/**
+ * @return true if the cell is in the DDRAM line the marquee uses
+ */
+static inline bool lcd_inMarquee(uint8_t bufPos) {
+    return tsLcd.marqueeState != LCD_MARQUEE_OFF && ((bufPos / LCD_COLUMNS) & 0x01) == tsLcd.marqueeLine;
 }
 
 /**
- * @brief redraw the whole screen from the video buffer
+ * @brief find the first cell which needs to be sent
+ * 
+ * Cells in the DDRAM line of a running marquee stay dirty until it is stopped.
+ * 
+ * @return the buffer position or LCD_BUFFER_LEN if all cells are up to date
  */
-void lcd_repaint(void) {
-    tsLcd.repaint = true; // start repainting
+static uint8_t lcd_nextDirty(void) {
+    for (uint8_t bufPos=0; bufPos < LCD_BUFFER_LEN; bufPos++) {
+        uint8_t bits = tsLcd.dirty[bufPos >> 3];
+        if (bits == 0) {
+            // skip the whole byte
+            bufPos |= 0x07;
+        }
+        else if ((bits & (1 << (bufPos & 0x07))) && !lcd_inMarquee(bufPos)) {
+            return bufPos;
+        }
+    }
+    return LCD_BUFFER_LEN;
 }
 
 /**
  * @brief clear the whole video butter with blanks
- * Use lcd_repaint() to repaint the screen afterwards
  */
 void lcd_clear(void) {
-    for (int i=0; i < LCD_BUFFER_LEN; i++) {
-        tsLcd.videoBuffer[i] = ' ';
+    lcd_clearScreen(tsLcd.screen);
+}
+
+void lcd_clearScreen(uint8_t screen) {
+    if (screen >= LCD_SCREENS) {
+        return;
+    }
+    for (uint8_t i=0; i < LCD_BUFFER_LEN; i++) {
+        lcd_setScreenCell(screen, i, ' ');
     }
 }
 
 
 /**
  * @brief write a text into the video buffer
- * Use lcd_repaint() to repaint the screen afterwards
+ * Only cells which actually change get sent to the display.
  * 
  * @param row 0-based row
  * @param column 0-based column
  * @param pText zero terminated text to copy
  */
 void lcd_print(uint8_t row, uint8_t column, char* pText) {
-    uint8_t bufPos = (row * 10) + column; // signed int to protect overflow
+    lcd_printScreen(tsLcd.screen, row, column, pText);
+}
+
+void lcd_printScreen(uint8_t screen, uint8_t row, uint8_t column, char* pText) {
+    if (screen >= LCD_SCREENS) {
+        return;
+    }
+
+    uint16_t bufPos = (row * LCD_COLUMNS) + column; // 16 bit to protect overflow
     
     int i=0;
     while (bufPos < LCD_BUFFER_LEN && pText[i] != 0) {
-        tsLcd.videoBuffer[bufPos++] = pText[i++];
+        lcd_setScreenCell(screen, bufPos++, pText[i++]);
+    }
+}
+
+void lcd_setGlyphs(const uint8_t* pGlyphs, uint8_t glyphCount) {
+    tsLcd.pGlyphs = pGlyphs;
+    tsLcd.glyphCount = glyphCount;
+    for (uint8_t i=0; i < LCD_CGRAM_SLOTS; i++) {
+        tsLcd.slotGlyph[i] = 0xFF;
+    }
+    // pending uploads are for the old glyphs
+    tsLcd.cgramDirty = 0;
+}
+
+char lcd_glyph(uint8_t glyphId) {
+    if (glyphId >= tsLcd.glyphCount) {
+        return ' ';
+    }
+
+    uint8_t slot = 0xFF;
+    uint8_t oldest = 0;
+    for (uint8_t i=0; i < LCD_CGRAM_SLOTS; i++) {
+        if (tsLcd.slotGlyph[i] == glyphId) {
+            slot = i;
+            break;
+        }
+        if (tsLcd.slotAge[i] > tsLcd.slotAge[oldest]) {
+            oldest = i;
+        }
+    }
+
+    if (slot == 0xFF) {
+        // replace the least recently used glyph
+        slot = oldest;
+        tsLcd.slotGlyph[slot] = glyphId;
+        tsLcd.cgramDirty |= 1 << slot;
+    }
+
+    for (uint8_t i=0; i < LCD_CGRAM_SLOTS; i++) {
+        if (tsLcd.slotAge[i] < tsLcd.slotAge[slot]) {
+            tsLcd.slotAge[i]++;
+        }
+    }
+    tsLcd.slotAge[slot] = 0;
+
+    return LCD_CGRAM_CHAR(slot);
+}
+
+void lcd_printGlyph(uint8_t row, uint8_t column, uint8_t glyphId) {
+    uint16_t bufPos = (row * LCD_COLUMNS) + column;
+    if (bufPos < LCD_BUFFER_LEN) {
+        lcd_setCell(bufPos, lcd_glyph(glyphId));
+    }
+}
+
+void lcd_marqueeStart(uint8_t row, const char* pText, uint16_t stepTicks) {
+    uint8_t i = 0;
+    while (i < LCD_MARQUEE_LEN && pText[i] != 0) {
+        tsLcd.marqueeText[i] = pText[i];
+        i++;
+    }
+    while (i < LCD_MARQUEE_LEN) {
+        tsLcd.marqueeText[i++] = ' ';
+    }
+
+    if (tsLcd.marqueeState != LCD_MARQUEE_OFF && tsLcd.marqueeLine != (row & 0x01)) {
+        // the other line still shows the old marquee text
+        for (uint8_t bufPos=0; bufPos < LCD_BUFFER_LEN; bufPos++) {
+            if (lcd_inMarquee(bufPos)) {
+                tsLcd.dirty[bufPos >> 3] |= 1 << (bufPos & 0x07);
+            }
+        }
+    }
+
+    tsLcd.marqueeLine = row & 0x01;
+    tsLcd.marqueeStepTicks = stepTicks;
+    tsLcd.marqueeRestart = true;
+    tsLcd.marqueeState = LCD_MARQUEE_LOAD;
+}
+
+void lcd_marqueeStop(void) {
+    if (tsLcd.marqueeState != LCD_MARQUEE_OFF) {
+        tsLcd.marqueeState = LCD_MARQUEE_STOP;
     }
 }
 
@@ -228,39 +471,137 @@ PT_THREAD(task_lcd(void))
 {
     PT_BEGIN(&tsLcd.pt);
 
-    if (tsLcd.repaint) {
-        tsLcd.repaintPos = 0;
-        tsLcd.repaint=false;
-
-        lcd_setPosition(0, 0);
-        tsLcd.timer = TASK_TIMER.CNT;
-        PT_YIELD_UNTIL(&tsLcd.pt, isAfter(tsLcd.timer, LCD_DISP_WAIT));
+    if (!tsLcd.initialised) {
+        // display needs some time to start working.
+        LCD_WAIT_MS(20);
+
+        // magic reset, those are 8-bit commands
+        LCD_RS_PORT.OUTCLR = LCD_RS; //RS=0 means instruction
+        lcd_sendNibble(0x30);
+        LCD_WAIT_MS(5);
+        lcd_sendNibble(0x30);
+        LCD_WAIT_MS(1);
+        lcd_sendNibble(0x30);
+        LCD_WAIT_MS(1);
+
+#ifdef LCD_BUS_8BIT
+        // stay in 8bit mode with 2line and 5x8
+        lcd_command(LCD_COMMAND_FNSET | LCD_FNSET_8BIT | 0x08);
+#else
+        // enable 4bit mode, this itself is a 8-bit command
+        lcd_sendNibble(LCD_COMMAND_4BIT);
+        LCD_WAIT_MS(1);
+
+        // and now switch to 2line with 5x8 mode
+        lcd_command(LCD_COMMAND_FNSET | 0x08);
+#endif
+        LCD_WAIT_READY();
+
+        lcd_command(LCD_COMMAND_DISPONOFF | 0x04); // display on, but no cursor nor blinking
+        LCD_WAIT_READY();
+
+        lcd_command(LCD_COMMAND_CLEAR);
+#ifdef LCD_RW
+        PT_WAIT_UNTIL(&tsLcd.pt, !lcd_busy()); // CLEAR and HOME take ms
+#else
+        LCD_WAIT_MS(LCD_CLEAR_WAIT_MS);
+#endif
+
+        tsLcd.cursor = 0;
+        tsLcd.initialised = true;
+    }
 
-        while (tsLcd.repaintPos < LCD_BUFFER_LEN) {
-            lcd_data(tsLcd.videoBuffer[tsLcd.repaintPos]);
-            tsLcd.timer = TASK_TIMER.CNT;
-            PT_YIELD_UNTIL(&tsLcd.pt, isAfter(tsLcd.timer, LCD_DISP_WAIT));
+    while (true) {
+        if (tsLcd.cgramDirty != 0) {
+            // upload glyphs before the cells showing them
+            tsLcd.cgramSlot = 0;
+            while (!(tsLcd.cgramDirty & (1 << tsLcd.cgramSlot))) {
+                tsLcd.cgramSlot++;
+            }
+            tsLcd.cgramDirty &= ~(1 << tsLcd.cgramSlot);
+
+            lcd_command(LCD_COMMAND_SET_CGRAM | (tsLcd.cgramSlot << 3));
+            tsLcd.cursor = 0xFF; // the address counter now points into the CGRAM
+            LCD_WAIT_READY();
+
+            for (tsLcd.cgramRow = 0; tsLcd.cgramRow < 8; tsLcd.cgramRow++) {
+                if (tsLcd.slotGlyph[tsLcd.cgramSlot] == 0xFF) {
+                    // lcd_setGlyphs dropped the glyph while we were waiting
+                    break;
+                }
+                lcd_data(pgm_read_byte(&tsLcd.pGlyphs[(uint16_t) tsLcd.slotGlyph[tsLcd.cgramSlot] * 8 + tsLcd.cgramRow]));
+                LCD_WAIT_READY();
+            }
+            continue;
+        }
 
-            tsLcd.repaintPos++;
+        if (tsLcd.marqueeState == LCD_MARQUEE_LOAD) {
+            // fill the whole DDRAM line, most of it is off-screen
+            tsLcd.marqueeRestart = false;
+            lcd_command(LCD_COMMAND_SET_DDRAM | (tsLcd.marqueeLine ? LCD_ADDR_LINE2 : LCD_ADDR_LINE1));
+            tsLcd.cursor = 0xFF;
+            LCD_WAIT_READY();
 
-            if (tsLcd.repaintPos == 10) {
-                lcd_setPosition(1, 0);
-                tsLcd.timer = TASK_TIMER.CNT;
-                PT_YIELD_UNTIL(&tsLcd.pt, isAfter(tsLcd.timer, LCD_DISP_WAIT));
+            for (tsLcd.marqueePos = 0; tsLcd.marqueePos < LCD_MARQUEE_LEN; tsLcd.marqueePos++) {
+                lcd_data(tsLcd.marqueeText[tsLcd.marqueePos]);
+                LCD_WAIT_READY();
             }
-            else if (tsLcd.repaintPos == 20) {
-                lcd_setPosition(2, 0);
-                tsLcd.timer = TASK_TIMER.CNT;
-                PT_YIELD_UNTIL(&tsLcd.pt, isAfter(tsLcd.timer, LCD_DISP_WAIT));
+
+            if (tsLcd.marqueeState == LCD_MARQUEE_LOAD && !tsLcd.marqueeRestart) {
+                tsLcd.marqueeLastStep = systick_ticks();
+                tsLcd.marqueeState = LCD_MARQUEE_RUN;
             }
-            else if (tsLcd.repaintPos == 30) {
-                lcd_setPosition(3, 0);
-                tsLcd.timer = TASK_TIMER.CNT;
-                PT_YIELD_UNTIL(&tsLcd.pt, isAfter(tsLcd.timer, LCD_DISP_WAIT));
+            continue;
+        }
+
+        if (tsLcd.marqueeState == LCD_MARQUEE_STOP) {
+            // move the display window back and repaint what the marquee overwrote
+            lcd_command(LCD_COMMAND_HOME);
+#ifdef LCD_RW
+            PT_WAIT_UNTIL(&tsLcd.pt, !lcd_busy()); // CLEAR and HOME take ms
+#else
+            LCD_WAIT_MS(LCD_CLEAR_WAIT_MS);
+#endif
+            tsLcd.cursor = 0;
+
+            if (tsLcd.marqueeState == LCD_MARQUEE_STOP) {
+                for (uint8_t bufPos=0; bufPos < LCD_BUFFER_LEN; bufPos++) {
+                    if (lcd_inMarquee(bufPos)) {
+                        tsLcd.dirty[bufPos >> 3] |= 1 << (bufPos & 0x07);
+                    }
+                }
+                tsLcd.marqueeState = LCD_MARQUEE_OFF;
             }
+            continue;
+        }
+
+        if (tsLcd.marqueeState == LCD_MARQUEE_RUN && systick_ticks() - tsLcd.marqueeLastStep >= tsLcd.marqueeStepTicks) {
+            // a single command moves the whole text by one character
+            tsLcd.marqueeLastStep += tsLcd.marqueeStepTicks;
+            lcd_command(LCD_COMMAND_DISPSHIFT | LCD_DISPSHIFT_DISPLAY);
+            LCD_WAIT_READY();
+            continue;
         }
+
+        if ((tsLcd.repaintPos = lcd_nextDirty()) >= LCD_BUFFER_LEN) {
+            break;
+        }
+
+        if (tsLcd.cursor != lcdAddr[tsLcd.repaintPos / LCD_COLUMNS] + tsLcd.repaintPos % LCD_COLUMNS) {
+            // only jump if the cell doesn't follow the last one written
+            lcd_setPosition(tsLcd.repaintPos / LCD_COLUMNS, tsLcd.repaintPos % LCD_COLUMNS);
+            LCD_WAIT_READY();
+        }
+
+        // clear it first, a print while we wait marks it dirty again
+        tsLcd.dirty[tsLcd.repaintPos >> 3] &= ~(1 << (tsLcd.repaintPos & 0x07));
+        lcd_data(tsLcd.videoBuffer[tsLcd.screen][tsLcd.repaintPos]);
+
+        // the controller moves on to the next DDRAM address by itself
+        tsLcd.cursor = lcdAddr[tsLcd.repaintPos / LCD_COLUMNS] + tsLcd.repaintPos % LCD_COLUMNS + 1;
+
+        LCD_WAIT_READY();
     }
     
     PT_END(&tsLcd.pt);
 }
-
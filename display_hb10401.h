@@ -29,25 +29,36 @@
  * This library allows to control the HB10401 display.
  * This is a 4 row, 10 character display from Pollin and other resellers.
  * It originally is from a Siemens Logo 12/24RC SPS.
+ * Other HD44780 displays like 16x2 or 20x4 work as well,
+ * just define LCD_COLUMNS and LCD_ROWS accordingly.
  * 
  * The code is optimised for low latency and has a 10 character buffer.
  * Displaying a character minimally takes 40uS for the LCD controller.
  * Thus writing 10 characters would keep us busy for half a ms with mostly idle loops.
  * To avoid such a situation the public api only writes to a buffer.
  * From the buffer one char at a time is transferred to the controller in a task worker.
+ * Only characters which differ from what the display already shows get transferred.
  * 
  */
 
 #include "strub_common.h"
+#include "systick.h"
 
 #include <avr/io.h>
 #include "pt.h"
 
 #define LCD_DATA_PORT PORTC // LCD data pins
-#define LCD_D4      PIN3_bm
-#define LCD_D5      PIN2_bm
-#define LCD_D6      PIN1_bm
-#define LCD_D7      PIN0_bm
+#ifdef LCD_BUS_8BIT
+    // D0..D7 are wired to PIN0..PIN7 of LCD_DATA_PORT, each character is a single EN strobe
+    #define LCD_D7      PIN7_bm
+    #define LCD_DATA_MASK 0xFF
+#else
+    #define LCD_D4      PIN3_bm
+    #define LCD_D5      PIN2_bm
+    #define LCD_D6      PIN1_bm
+    #define LCD_D7      PIN0_bm
+    #define LCD_DATA_MASK (LCD_D4 | LCD_D5 | LCD_D6 | LCD_D7)
+#endif
 
 #define LCD_EN_PORT PORTB
 #define LCD_EN      PIN0_bm // LCD Enable pin
@@ -56,33 +67,76 @@
 #define LCD_RS      PIN1_bm // LCD Register Select 0..Command, 1..Data
 
 
-// we don't read ;) set fixed to GND == write #define LCD_RW      PB6 // Read/!Write
+// RW is usually fixed to GND == write and we wait the worst case time after each command.
+// Define LCD_RW_PORT and LCD_RW to read the busy flag instead and continue as soon as the
+// controller is ready, e.g.
+// #define LCD_RW_PORT PORTB
+// #define LCD_RW      PIN2_bm // Read/!Write
 
-#define LCD_ADDR_LINE1  0x00
-#define LCD_ADDR_LINE2  0x40
-#define LCD_ADDR_LINE3  0x0A
-#define LCD_ADDR_LINE4  0x4A
+// the display geometry, defaults to the HB10401
+#ifndef LCD_COLUMNS
+    #define LCD_COLUMNS 10
+#endif
+#ifndef LCD_ROWS
+    #define LCD_ROWS 4
+#endif
+#if LCD_ROWS > 4 || LCD_COLUMNS * LCD_ROWS > 80
+    #error "the HD44780 supports at most 4 rows and 80 characters"
+#endif
+
+// the controller has 2 lines of 40 characters, row 3 and 4 continue row 1 and 2
+#define LCD_ROW_ADDR(row) ((((row) & 0x01) ? 0x40 : 0x00) + ((row) >> 1) * LCD_COLUMNS)
+
+#define LCD_ADDR_LINE1  LCD_ROW_ADDR(0)
+#define LCD_ADDR_LINE2  LCD_ROW_ADDR(1)
+#define LCD_ADDR_LINE3  LCD_ROW_ADDR(2)
+#define LCD_ADDR_LINE4  LCD_ROW_ADDR(3)
 
 #define LCD_COMMAND_CLEAR       0x01
 #define LCD_COMMAND_HOME        0x02
 #define LCD_COMMAND_ENTRYMODE   0x04 // + bit1=right, bit0=shift
 #define LCD_COMMAND_DISPONOFF   0x08 // + bit2=entire display_on, bit1=cursor_on, bit0=blink_on
 #define LCD_COMMAND_DISPSHIFT   0x10 // + bit3=SC, bit2=RL
+#define LCD_DISPSHIFT_DISPLAY   0x08 // + dispshift: shift the display instead of moving the cursor
+#define LCD_DISPSHIFT_RIGHT     0x04 // + dispshift: to the right instead of the left
 #define LCD_COMMAND_FNSET       0x20 
 #define LCD_COMMAND_4BIT        0x20 // identical to fnset 5x8, 1 line but is actually an 8-bit command
+#define LCD_FNSET_8BIT          0x10 // + fnset for the 8-bit data bus
 #define LCD_COMMAND_SET_CGRAM   0x40 // + 6 bit address
 #define LCD_COMMAND_SET_DDRAM   0x80 // + 7 bit address
 
-static const uint8_t lcdAddr[] = {LCD_ADDR_LINE1, LCD_ADDR_LINE2, LCD_ADDR_LINE3, LCD_ADDR_LINE4};
-
 // **** LCD processing structure **** 
 
-#define LCD_BUFFER_LEN 40
-#define LCD_DISP_WAIT 480 // how many cycles an LCD command takes to execute, which is about 40µS
+#define LCD_BUFFER_LEN (LCD_COLUMNS * LCD_ROWS)
+
+// each DDRAM line holds 40 characters, the marquee uses a whole line
+#define LCD_MARQUEE_LEN 40
+
+// number of virtual screens which can be written independently
+#ifndef LCD_SCREENS
+    #define LCD_SCREENS 1
+#endif
+#define LCD_DISP_WAIT SYSTICK_US(48) // how long an LCD command takes to execute, 37µS plus some margin
+#define LCD_EN_PULSE_US 0.5 // min EN high time and data setup before the falling edge, 450ns at 3V
+
+// how long the CLEAR command takes if the busy flag can't be read, the datasheet says 1.52ms
+#ifndef LCD_CLEAR_WAIT_MS
+    #define LCD_CLEAR_WAIT_MS 2
+#endif
+
+// the number of user defined characters of the controller
+#define LCD_CGRAM_SLOTS 8
+
+// the character code showing a CGRAM slot, 0x08..0x0F mirror 0x00..0x07 and avoid the 0 terminator
+#define LCD_CGRAM_CHAR(slot) (0x08 | (slot))
 
 
 /**
  * @brief configures the LCD subsystem
+ * 
+ * This only sets up the pins and returns right away.
+ * The display gets initialised by #task_lcd without blocking,
+ * text printed in the meantime shows up once that is done.
  */
 void setup_lcd(void);
 
@@ -91,17 +145,19 @@ PT_THREAD(task_lcd(void));
 
 /**
  * @brief redraw the whole screen from the video buffer
+ * 
+ * Changed characters get drawn anyway,
+ * this is only needed if the display content got lost.
  */
 void lcd_repaint(void);
 
 /**
- * @brief clear the whole video butter with blanks
- * Use lcd_repaint() to repaint the screen afterwards
+ * @brief clear the whole video butter of the shown screen with blanks
  */
 void lcd_clear(void);
 
 /**
- * @brief write a text into the video buffer
+ * @brief write a text into the video buffer of the shown screen
  * 
  * @param row 0-based row
  * @param column 0-based column
@@ -109,6 +165,97 @@ void lcd_clear(void);
  */
 void lcd_print(uint8_t row, uint8_t column, char* pText);
 
+/**
+ * @brief switch the screen which is shown on the display
+ * 
+ * Only the characters which differ between both screens get sent.
+ * 
+ * @param screen 0..LCD_SCREENS-1
+ */
+void lcd_selectScreen(uint8_t screen);
+
+/**
+ * @return the screen which is shown on the display
+ */
+uint8_t lcd_getScreen(void);
+
+/**
+ * @brief clear a screen with blanks
+ * 
+ * @param screen 0..LCD_SCREENS-1
+ */
+void lcd_clearScreen(uint8_t screen);
+
+/**
+ * @brief write a text into the video buffer of a screen
+ * 
+ * Writing to a screen which is not shown only changes the video buffer.
+ * 
+ * @param screen 0..LCD_SCREENS-1
+ * @param row 0-based row
+ * @param column 0-based column
+ * @param pText zero terminated text to copy
+ */
+void lcd_printScreen(uint8_t screen, uint8_t row, uint8_t column, char* pText);
+
+/**
+ * @brief set the user defined glyphs
+ * 
+ * Each glyph is 8 bytes in PROGMEM, one byte per pixel row with the 5 LSBs used.
+ * There can be more glyphs than CGRAM slots, they get mapped onto the
+ * LCD_CGRAM_SLOTS slots on demand.
+ * 
+ * @param pGlyphs the glyphs in PROGMEM
+ * @param glyphCount number of glyphs
+ */
+void lcd_setGlyphs(const uint8_t* pGlyphs, uint8_t glyphCount);
+
+/**
+ * @brief get the character code of a user defined glyph
+ * 
+ * If the glyph is not in the CGRAM yet, the least recently used slot gets
+ * replaced and task_lcd uploads the glyph before the next characters.
+ * Cells still showing the replaced glyph change as well,
+ * so at most LCD_CGRAM_SLOTS different glyphs should be visible at a time.
+ * 
+ * @param glyphId index into the glyphs passed to #lcd_setGlyphs
+ * @return the character code to print
+ */
+char lcd_glyph(uint8_t glyphId);
+
+/**
+ * @brief write a user defined glyph into the video buffer
+ * 
+ * @param row 0-based row
+ * @param column 0-based column
+ * @param glyphId index into the glyphs passed to #lcd_setGlyphs
+ */
+void lcd_printGlyph(uint8_t row, uint8_t column, uint8_t glyphId);
+
+/**
+ * @brief scroll a text of up to LCD_MARQUEE_LEN characters through a row
+ * 
+ * The text gets written once into the whole DDRAM line of the row, mostly off-screen.
+ * Then the controller shifts the display window by one character per step,
+ * which costs a single command instead of rewriting the row.
+ * 
+ * Note that the controller always shifts the whole display, so all other rows
+ * scroll along. Rows sharing the DDRAM line with the marquee, e.g. row 2 for row 0 on
+ * a 4 line display, show the marquee text and don't get updated until #lcd_marqueeStop.
+ * 
+ * @param row 0-based row, only its DDRAM line (row & 1) matters
+ * @param pText zero terminated text, gets copied
+ * @param stepTicks TASK ticks between two steps, e.g. SYSTICK_MS_TO_TICKS(300)
+ */
+void lcd_marqueeStart(uint8_t row, const char* pText, uint16_t stepTicks);
+
+/**
+ * @brief stop the marquee and move the display window back
+ * 
+ * The overwritten rows get repainted from the video buffer.
+ */
+void lcd_marqueeStop(void);
+
 /**
  * @brief print a 32bit unsigned hex value to the screen
  */
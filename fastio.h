@@ -0,0 +1,153 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __FASTIO_H__
+    #define __FASTIO_H__
+
+/**
+ * @file fastio.h
+ * @author Mark Struberg (struberg@apache.org)
+ * @brief single cycle pin access for the bit-banging drivers
+ *
+ * The PORTx registers are in the extended IO space and every access is a 2 cycle sts.
+ * Each PORTx is mirrored by a VPORTx in the lower IO space which can be changed
+ * with a single sbi/cbi instruction.
+ *
+ * The macros take the usual PORTx and a pin bitmask, e.g. FIO_SET(PORTA, PIN3_bm).
+ * If both are compile time constants and the mask has a single bit set,
+ * each access compiles to a single sbi/cbi, which is atomic.
+ * For a runtime PORT_t or a mask with multiple bits the VPORT access would be
+ * a read-modify-write which an ISR on the same port could interfere with,
+ * so those fall back to the OUTSET/OUTCLR/DIRSET/DIRCLR registers.
+ */
+
+#include <avr/io.h>
+#include <stdint.h>
+
+/**
+ * @brief the VPORT which mirrors the given PORT
+ *
+ * The PORTs and VPORTs are laid out in the same order,
+ * so the PORT index is the VPORT index.
+ */
+#define FIO_VPORT(port)             ((&VPORTA)[&(port) - &PORTA])
+
+/**
+ * @brief whether the access compiles to a single atomic sbi/cbi
+ */
+#define FIO_ATOMIC(port, mask) \
+    (__builtin_constant_p(&(port)) && __builtin_constant_p(mask) && ((mask) & ((mask) - 1)) == 0)
+
+#define FIO_SET(port, mask) \
+    do { if (FIO_ATOMIC(port, mask)) FIO_VPORT(port).OUT |= (mask); else (port).OUTSET = (mask); } while (0)
+#define FIO_CLR(port, mask) \
+    do { if (FIO_ATOMIC(port, mask)) FIO_VPORT(port).OUT &= (uint8_t) ~(mask); else (port).OUTCLR = (mask); } while (0)
+#define FIO_READ(port, mask)        (FIO_VPORT(port).IN & (mask))
+#define FIO_DIR_OUT(port, mask) \
+    do { if (FIO_ATOMIC(port, mask)) FIO_VPORT(port).DIR |= (mask); else (port).DIRSET = (mask); } while (0)
+#define FIO_DIR_IN(port, mask) \
+    do { if (FIO_ATOMIC(port, mask)) FIO_VPORT(port).DIR &= (uint8_t) ~(mask); else (port).DIRCLR = (mask); } while (0)
+
+/**
+ * @brief cycles to wait for at least the given ns
+ */
+#define FIO_NS_TO_CYCLES(ns)        (((F_CPU / 1000000UL) * (ns) + 999UL) / 1000UL)
+
+/**
+ * @brief shift out a single bit, the receiver samples on the rising clock edge
+ * 
+ * The clock is only high for a single cycle, so this is only for chips
+ * which can take ~10MHz like the MAX7219 or the 74HC595.
+ */
+#define FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, data, bit) \
+    FIO_CLR(clkPort, clkMask); \
+    if ((data) & (bit)) { \
+        FIO_SET(dataPort, dataMask); \
+    } \
+    else { \
+        FIO_CLR(dataPort, dataMask); \
+    } \
+    FIO_SET(clkPort, clkMask);
+// END define
+
+/**
+ * @brief shift out a single bit, the clock stays low and high for at least halfCycles each
+ */
+#define FIO_SHIFT_BIT_DELAYED(clkPort, clkMask, dataPort, dataMask, data, bit, halfCycles) \
+    FIO_CLR(clkPort, clkMask); \
+    if ((data) & (bit)) { \
+        FIO_SET(dataPort, dataMask); \
+    } \
+    else { \
+        FIO_CLR(dataPort, dataMask); \
+    } \
+    __builtin_avr_delay_cycles(halfCycles); \
+    FIO_SET(clkPort, clkMask); \
+    __builtin_avr_delay_cycles(halfCycles);
+// END define
+
+/**
+ * @brief shift out a byte starting with the MSB, fully unrolled
+ *
+ * The clock is left high.
+ */
+#define FIO_SHIFT_OUT_MSB_FIRST(clkPort, clkMask, dataPort, dataMask, data) \
+    do { \
+        uint8_t fio_data = (data); \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x80) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x40) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x20) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x10) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x08) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x04) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x02) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x01) \
+    } while (0)
+// END define
+
+/**
+ * @brief shift out a byte starting with the LSB, fully unrolled
+ *
+ * The clock is left high.
+ */
+#define FIO_SHIFT_OUT_LSB_FIRST(clkPort, clkMask, dataPort, dataMask, data) \
+    do { \
+        uint8_t fio_data = (data); \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x01) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x02) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x04) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x08) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x10) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x20) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x40) \
+        FIO_SHIFT_BIT(clkPort, clkMask, dataPort, dataMask, fio_data, 0x80) \
+    } while (0)
+// END define
+
+/**
+ * @brief shift out a byte starting with the LSB for slower chips like the TM1638
+ *
+ * The clock stays low and high for at least halfCycles each and is left high.
+ */
+#define FIO_SHIFT_OUT_LSB_FIRST_DELAYED(clkPort, clkMask, dataPort, dataMask, data, halfCycles) \
+    do { \
+        uint8_t fio_data = (data); \
+        for (uint8_t fio_bit = 0x01; fio_bit != 0; fio_bit <<= 1) { \
+            FIO_SHIFT_BIT_DELAYED(clkPort, clkMask, dataPort, dataMask, fio_data, fio_bit, halfCycles) \
+        } \
+    } while (0)
+// END define
+
+#endif
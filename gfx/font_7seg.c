@@ -0,0 +1,115 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "font_7seg.h"
+
+#include <avr/pgmspace.h>
+
+/**
+ * @brief segment patterns for ASCII 0x20..0x7F
+ */
+PROGMEM const uint8_t font7seg_ascii[] = {
+    0x00, 0x86, 0x22, 0x00, 0x6D, 0x52, 0x00, 0x20,   // SP ! " # $ % & '
+    0x39, 0x0F, 0x00, 0x00, 0x80, 0x40, 0x80, 0x52,   // ( ) * + , - . /
+    0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07,   // 0 1 2 3 4 5 6 7
+    0x7F, 0x67, 0x00, 0x00, 0x00, 0x48, 0x00, 0x53,   // 8 9 : ; < = > ?
+    0x5F, 0x77, 0x7C, 0x39, 0x5E, 0x79, 0x71, 0x3D,   // @ A B C D E F G
+    0x76, 0x30, 0x1E, 0x75, 0x38, 0x37, 0x54, 0x3F,   // H I J K L M N O
+    0x73, 0x67, 0x50, 0x6D, 0x78, 0x3E, 0x1C, 0x7E,   // P Q R S T U V W
+    0x76, 0x6E, 0x5B, 0x39, 0x64, 0x0F, 0x23, 0x08,   // X Y Z [ \ ] ^ _
+    0x02, 0x5F, 0x7C, 0x58, 0x5E, 0x7B, 0x71, 0x6F,   // ` a b c d e f g
+    0x74, 0x10, 0x0E, 0x75, 0x30, 0x55, 0x54, 0x5C,   // h i j k l m n o
+    0x73, 0x67, 0x50, 0x6D, 0x78, 0x1C, 0x1C, 0x2A,   // p q r s t u v w
+    0x76, 0x6E, 0x5B, 0x39, 0x30, 0x0F, 0x01, 0x00,   // x y z { | } ~ DEL
+};
+
+uint8_t font7seg_char(char c) {
+    uint8_t idx = (uint8_t) c - ' ';
+    if (idx >= sizeof(font7seg_ascii)) {
+        return 0x00;
+    }
+    return pgm_read_byte(&font7seg_ascii[idx]);
+}
+
+uint8_t font7seg_hex(uint8_t val) {
+    val &= 0x0F;
+    return font7seg_char(val < 10 ? '0' + val : 'A' - 10 + val);
+}
+
+uint8_t font7seg_print(uint8_t* pSegments, uint8_t len, const char* pText) {
+    uint8_t pos = 0;
+    while (*pText != 0) {
+        if (*pText == '.' && pos > 0 && !(pSegments[pos - 1] & SEG7_DP)) {
+            pSegments[pos - 1] |= SEG7_DP;
+        }
+        else if (pos < len) {
+            pSegments[pos++] = font7seg_char(*pText);
+        }
+        else {
+            break;
+        }
+        pText++;
+    }
+
+    uint8_t used = pos;
+    while (pos < len) {
+        pSegments[pos++] = 0x00;
+    }
+    return used;
+}
+
+bool font7seg_printNumber(uint8_t* pSegments, uint8_t len, int32_t value, uint8_t decimals) {
+    bool negative = value < 0;
+    uint32_t rest = negative ? -(uint32_t) value : (uint32_t) value;
+
+    // fill from the rightmost digit
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t* pSegment = &pSegments[len - 1 - i];
+        if (rest != 0 || i <= decimals) {
+            *pSegment = font7seg_char('0' + rest % 10);
+            rest = rest / 10;
+            if (decimals > 0 && i == decimals) {
+                *pSegment |= SEG7_DP;
+            }
+        }
+        else if (negative) {
+            *pSegment = SEG7_G;
+            negative = false;
+        }
+        else {
+            *pSegment = 0x00;
+        }
+    }
+
+    if (rest != 0 || negative) {
+        for (uint8_t i = 0; i < len; i++) {
+            pSegments[i] = SEG7_G;
+        }
+        return false;
+    }
+    return true;
+}
+
+uint8_t font7seg_toMax7219(uint8_t segments) {
+    uint8_t data = segments & SEG7_DP;
+    uint8_t target = 0x40;
+    for (uint8_t bit = SEG7_A; bit != SEG7_DP; bit <<= 1) {
+        if (segments & bit) {
+            data |= target;
+        }
+        target >>= 1;
+    }
+    return data;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __FONT_7SEG_H__
+    #define __FONT_7SEG_H__
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+/**
+ * @brief 7-segment font shared by the 7-segment displays
+ * 
+ * The segments are encoded as following
+ *      ** 01 **
+ *      20    02
+ *      ** 40 **
+ *      10    04
+ *      ** 08 ** 80
+ * 
+ * This is the native bit order of the TM1638.
+ * Use #font7seg_toMax7219 for MAX7219 modules in no-decode mode.
+ * 
+ * A segment buffer holds one byte per digit, the first byte is the leftmost digit.
+ */
+
+#define SEG7_A  0x01
+#define SEG7_B  0x02
+#define SEG7_C  0x04
+#define SEG7_D  0x08
+#define SEG7_E  0x10
+#define SEG7_F  0x20
+#define SEG7_G  0x40
+#define SEG7_DP 0x80
+
+/**
+ * @brief the segment pattern of an ASCII character
+ * 
+ * Letters which can't be shown properly get the closest look-alike,
+ * e.g. 'B' shows a 'b'. Characters outside 0x20..0x7F are blank.
+ */
+uint8_t font7seg_char(char c);
+
+/**
+ * @brief the segment pattern of a hex digit 0..F
+ */
+uint8_t font7seg_hex(uint8_t val);
+
+/**
+ * @brief render a text left aligned into a segment buffer
+ * 
+ * A '.' lights the decimal point of the previous digit instead of taking a digit,
+ * thus "12.5" only needs 3 digits. The rest of the buffer gets blanked.
+ * 
+ * @param pSegments the segment buffer
+ * @param len number of digits in the buffer
+ * @param pText 0 terminated text
+ * @return the number of digits used
+ */
+uint8_t font7seg_print(uint8_t* pSegments, uint8_t len, const char* pText);
+
+/**
+ * @brief render a right aligned signed number into a segment buffer
+ * 
+ * Leading digits are blank, a negative number gets a '-' in front.
+ * If the number does not fit all digits show a '-'.
+ * 
+ * @param pSegments the segment buffer
+ * @param len number of digits in the buffer
+ * @param value the number, e.g. -1234 with 2 decimals shows -12.34
+ * @param decimals number of digits after the decimal point, 0 for none
+ * @return false if the number did not fit
+ */
+bool font7seg_printNumber(uint8_t* pSegments, uint8_t len, int32_t value, uint8_t decimals);
+
+/**
+ * @brief convert a segment pattern to the MAX7219 no-decode bit order
+ * 
+ * The MAX7219 uses DP=0x80, A=0x40 ... G=0x01.
+ */
+uint8_t font7seg_toMax7219(uint8_t segments);
+
+#endif
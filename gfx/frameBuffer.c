@@ -22,12 +22,12 @@ void framebuffer_clear(FrameBuffer* pFrameBuffer) {
     }
 }
 
-void framebuffer_setPixel(FrameBuffer* pFrameBuffer, uint8_t xPos, uint8_t yPos, bool setClr) {
+void framebuffer_setPixel(FrameBuffer* pFrameBuffer, uint16_t xPos, uint8_t yPos, bool setClr) {
     if (yPos > pFrameBuffer->heigth || xPos > pFrameBuffer->width) {
         return;
     }
 
-    uint8_t bytePos = yPos * pFrameBuffer->widthBytes + xPos/8;
+    uint16_t bytePos = yPos * pFrameBuffer->widthBytes + xPos/8;
     uint8_t bitPos = xPos % 8;
     if (setClr) {
         // set the pixel
@@ -39,34 +39,34 @@ void framebuffer_setPixel(FrameBuffer* pFrameBuffer, uint8_t xPos, uint8_t yPos,
     }
 }
 
-bool framebuffer_getPixel(FrameBuffer* pFrameBuffer, uint8_t xPos, uint8_t yPos) {
+bool framebuffer_getPixel(FrameBuffer* pFrameBuffer, uint16_t xPos, uint8_t yPos) {
     if (yPos > pFrameBuffer->heigth || xPos > pFrameBuffer->width) {
         return false;
     }
 
-    uint8_t bytePos = yPos * pFrameBuffer->widthBytes + xPos/8;
+    uint16_t bytePos = yPos * pFrameBuffer->widthBytes + xPos/8;
     uint8_t bitPos = xPos % 8;
 
     return pFrameBuffer->buffer[bytePos] & 0x80>>bitPos;
 }
 
 
-void framebuffer_hline(FrameBuffer* pFrameBuffer, int8_t xPosStart, int8_t yPos, int8_t xPosEnd, bool setClr) {
+void framebuffer_hline(FrameBuffer* pFrameBuffer, int16_t xPosStart, int8_t yPos, int16_t xPosEnd, bool setClr) {
     if (yPos < 0 || yPos >= pFrameBuffer->heigth) {
         // not visible
         return;
     }
 
-    int8_t screenXStart = xPosStart < 0 ? 0 : xPosStart;
-    int8_t screenXEnd = xPosEnd >= pFrameBuffer->width ? pFrameBuffer->width - 1 : xPosEnd;
+    int16_t screenXStart = xPosStart < 0 ? 0 : xPosStart;
+    int16_t screenXEnd = xPosEnd >= (int16_t) pFrameBuffer->width ? (int16_t) pFrameBuffer->width - 1 : xPosEnd;
     
-    for (uint8_t x = screenXStart; x <= screenXEnd; x++) {
+    for (int16_t x = screenXStart; x <= screenXEnd; x++) {
         framebuffer_setPixel(pFrameBuffer, x, yPos, setClr);
     }
 }
 
-void framebuffer_vline(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPosStart, int8_t yPosEnd, bool setClr) {
-    if (xPos < 0 || xPos >= pFrameBuffer->width) {
+void framebuffer_vline(FrameBuffer* pFrameBuffer, int16_t xPos, int8_t yPosStart, int8_t yPosEnd, bool setClr) {
+    if (xPos < 0 || xPos >= (int16_t) pFrameBuffer->width) {
         // not visible
         return;
     }
@@ -27,10 +27,10 @@
  * It only supports monochrom displays for now.
  */
 typedef struct {
-    uint8_t width;      // width in pixels
-    uint8_t widthBytes; // width in bytes
-    uint8_t heigth;     // heigth in pixels
-    uint8_t bufferLen;  // the length of the buffer in bytes
+    uint16_t width;      // width in pixels
+    uint16_t widthBytes; // width in bytes
+    uint8_t heigth;      // heigth in pixels
+    uint16_t bufferLen;  // the length of the buffer in bytes
     uint8_t* buffer;
 } FrameBuffer;
 
@@ -49,7 +49,7 @@ void framebuffer_clear(FrameBuffer* pFrameBuffer);
  * @param yPos 
  * @param setClr true=set, false = clear pixel
  */
-void framebuffer_setPixel(FrameBuffer* pFrameBuffer, uint8_t xPos, uint8_t yPos, bool setClr);
+void framebuffer_setPixel(FrameBuffer* pFrameBuffer, uint16_t xPos, uint8_t yPos, bool setClr);
 
 /**
  * @brief detect whether the pixel on the position is set or not
@@ -60,7 +60,7 @@ void framebuffer_setPixel(FrameBuffer* pFrameBuffer, uint8_t xPos, uint8_t yPos,
  * @return true 
  * @return false 
  */
-bool framebuffer_getPixel(FrameBuffer* pFrameBuffer, uint8_t xPos, uint8_t yPos);
+bool framebuffer_getPixel(FrameBuffer* pFrameBuffer, uint16_t xPos, uint8_t yPos);
 
 /**
  * @brief draw a horizontal line
@@ -71,7 +71,7 @@ bool framebuffer_getPixel(FrameBuffer* pFrameBuffer, uint8_t xPos, uint8_t yPos)
  * @param xPosEnd must be higher than xPosStart 
  * @param setClr true=set, false = clear pixel
  */
-void framebuffer_hline(FrameBuffer* pFrameBuffer, int8_t xPosStart, int8_t yPos, int8_t xPosEnd, bool setClr);
+void framebuffer_hline(FrameBuffer* pFrameBuffer, int16_t xPosStart, int8_t yPos, int16_t xPosEnd, bool setClr);
 
 /**
  * @brief draw a vertical line
@@ -82,6 +82,6 @@ void framebuffer_hline(FrameBuffer* pFrameBuffer, int8_t xPosStart, int8_t yPos,
  * @param yPosEnd must be higher than yPosStart
  * @param setClr true=set, false = clear pixel
  */
-void framebuffer_vline(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPosStart, int8_t yPosEnd, bool setClr);
+void framebuffer_vline(FrameBuffer* pFrameBuffer, int16_t xPos, int8_t yPosStart, int8_t yPosEnd, bool setClr);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "grayFrameBuffer.h"
+
+void grayframebuffer_clear(GrayFrameBuffer* pGrayFrameBuffer) {
+    for (uint8_t plane = 0; plane < GRAY_PLANES; plane++) {
+        framebuffer_clear(&pGrayFrameBuffer->planes[plane]);
+    }
+}
+
+void grayframebuffer_setPixel(GrayFrameBuffer* pGrayFrameBuffer, uint16_t xPos, uint8_t yPos, uint8_t level) {
+    for (uint8_t plane = 0; plane < GRAY_PLANES; plane++) {
+        framebuffer_setPixel(&pGrayFrameBuffer->planes[plane], xPos, yPos, level & (1 << plane));
+    }
+}
+
+uint8_t grayframebuffer_getPixel(GrayFrameBuffer* pGrayFrameBuffer, uint16_t xPos, uint8_t yPos) {
+    uint8_t level = 0;
+    for (uint8_t plane = 0; plane < GRAY_PLANES; plane++) {
+        if (framebuffer_getPixel(&pGrayFrameBuffer->planes[plane], xPos, yPos)) {
+            level |= 1 << plane;
+        }
+    }
+    return level;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __GRAYFRAMEBUFFER_H__
+    #define __GRAYFRAMEBUFFER_H__
+
+#include <inttypes.h>
+
+#include "frameBuffer.h"
+
+// 2 bitplanes give 4 gray levels
+#define GRAY_PLANES 2
+#define GRAY_LEVELS (1 << GRAY_PLANES)
+
+/**
+ * @brief A frame buffer with multiple bitplanes
+ * Each plane is an ordinary monochrom FrameBuffer of the same size.
+ * Plane 0 holds the least significant bit of the gray level.
+ */
+typedef struct {
+    FrameBuffer planes[GRAY_PLANES];
+} GrayFrameBuffer;
+
+/**
+ * @brief clear all the planes
+ * 
+ * @param pGrayFrameBuffer 
+ */
+void grayframebuffer_clear(GrayFrameBuffer* pGrayFrameBuffer);
+
+/**
+ * @brief set the gray level of a pixel
+ * 
+ * @param pGrayFrameBuffer 
+ * @param xPos 
+ * @param yPos 
+ * @param level 0 (off) .. GRAY_LEVELS-1 (full brightness)
+ */
+void grayframebuffer_setPixel(GrayFrameBuffer* pGrayFrameBuffer, uint16_t xPos, uint8_t yPos, uint8_t level);
+
+/**
+ * @return uint8_t the gray level of the pixel
+ */
+uint8_t grayframebuffer_getPixel(GrayFrameBuffer* pGrayFrameBuffer, uint16_t xPos, uint8_t yPos);
+
+#endif
@@ -23,7 +23,7 @@
 
 
 
-void tile_place(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPos, Tile* pTile, bool full) {
+void tile_place(FrameBuffer* pFrameBuffer, int16_t xPos, int8_t yPos, Tile* pTile, bool full) {
     uint8_t width = ((pTile->size & 0x70) >> 4) + 1;
     uint8_t heigth = (pTile->size & 0x07) + 1;
 
@@ -37,7 +37,7 @@ void tile_place(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPos, Tile* pTile
 
     for (uint8_t tileY = tileStartY; tileY < heigth && screenY < pFrameBuffer->heigth; tileY++) {
         // row by row
-        uint8_t screenX = xPos;
+        uint16_t screenX = xPos;
         for (uint8_t tileX = tileStartX; tileX < width && screenX < pFrameBuffer->width; tileX++) {
             // pixels per row
             if (pTile->bytes[tileY] & (0x80 >> tileX)) {
@@ -52,7 +52,7 @@ void tile_place(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPos, Tile* pTile
     }
 }
 
-void tile_erase(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPos, Tile* pTile) {
+void tile_erase(FrameBuffer* pFrameBuffer, int16_t xPos, int8_t yPos, Tile* pTile) {
     uint8_t width = ((pTile->size & 0x70) >> 4) + 1;
     uint8_t heigth = (pTile->size & 0x07) + 1;
     
@@ -66,7 +66,7 @@ void tile_erase(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPos, Tile* pTile
 
     for (uint8_t tileY = tileStartY; tileY < heigth && screenY < pFrameBuffer->heigth; tileY++) {
         // row by row
-        uint8_t screenX = xPos;
+        uint16_t screenX = xPos;
         for (uint8_t tileX = tileStartX; tileX < width && screenX < pFrameBuffer->width; tileX++) {
             // pixels per row
             if (pTile->bytes[tileY] & (0x80 >> tileX)) {
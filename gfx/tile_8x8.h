@@ -59,7 +59,7 @@ typedef struct {
  * @param pTile 
  * @param full if true we will also clear non-set pixels, if false we will only set pixels
  */
-void tile_place(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPos, Tile* pTile, bool full);
+void tile_place(FrameBuffer* pFrameBuffer, int16_t xPos, int8_t yPos, Tile* pTile, bool full);
 
 /**
  * @brief erase the tile from the frame buffer on the given location
@@ -71,7 +71,7 @@ void tile_place(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPos, Tile* pTile
  * @param yPos 
  * @param pTile 
  */
-void tile_erase(FrameBuffer* pFrameBuffer, int8_t xPos, int8_t yPos, Tile* pTile);
+void tile_erase(FrameBuffer* pFrameBuffer, int16_t xPos, int8_t yPos, Tile* pTile);
 
 /**
  * @return uint8_t the width of the given tile
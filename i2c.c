@@ -116,3 +116,7 @@ void i2c_stop(void) {
         }
     }
 }
+
+bool i2c_busy(void) {
+    return (TWI0.MSTATUS & TWI_BUSSTATE_gm) == TWI_BUSSTATE_OWNER_gc;
+}
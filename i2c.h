@@ -46,4 +46,9 @@ bool i2c_read_bytes(uint8_t* pData, uint8_t len);
 
 void i2c_stop(void);
 
+/**
+ * @brief whether we currently own the bus, i.e. a transaction is not yet stopped
+ */
+bool i2c_busy(void);
+
 #endif
\ No newline at end of file
@@ -15,102 +15,435 @@
  */
 
 #include "max7219.h"
+#include "fastio.h"
 
+#include <stdbool.h>
+
+#ifdef MAX7219_USE_SPI
+    #include <avr/interrupt.h>
+#endif
+
+/**
+ * @brief the rows the modules currently show
+ * 
+ * Organised exactly like the FrameBuffer.
+ */
+static uint8_t shadow[MAX7219_MAX_MODULES * 8];
+
+// number of modules the shadow is valid for, 0 if invalid
+static uint8_t shadowModules = 0;
+
+// number of modules in the chain as passed to max7219_init
+static uint8_t chainModules = 0;
+
+// digits per module for the numeric display mode
+static uint8_t scanDigits[MAX7219_MAX_MODULES];
+
+// number of modules of the layout, 0 for a single row in chain order
+static uint8_t layoutModules = 0;
+static uint16_t layoutWidthBytes = 0;
+
+// frame buffer position of the top row of each module in chain order
+static uint16_t layoutOffset[MAX7219_MAX_MODULES];
+static uint8_t layoutRotation[MAX7219_MAX_MODULES];
+
+#ifdef MAX7219_USE_SPI
+
+/*
+ * The frames get queued in a ring buffer and shifted out by the SPI interrupt.
+ * Each frame is stored as a length byte followed by the data bytes,
+ * thus a single frame must fit into the queue.
+ * CS goes low before the first byte of a frame and high after its last byte.
+ */
+static volatile uint8_t spiQueue[MAX7219_SPI_QUEUE_LEN];
+static volatile uint8_t spiHead = 0; // end of the committed frames
+static volatile uint8_t spiTail = 0; // next byte to send
+static volatile bool spiActive = false;
+
+static uint8_t spiWritePos = 0;      // end of the frame currently being queued
+static uint8_t spiFrameStart = 0;    // position of its length byte
+static uint8_t spiRemaining = 0;     // bytes left of the frame being sent, ISR only
+
+static inline uint8_t max7219_spiNextPos(uint8_t pos) {
+    return pos + 1 >= MAX7219_SPI_QUEUE_LEN ? 0 : pos + 1;
+}
+
+/**
+ * @brief called whenever the SPI finished a byte
+ * 
+ * Must only be called from the ISR or with interrupts disabled.
+ */
+static void max7219_spiNext(void) {
+    SPI0.INTFLAGS = SPI_IF_bm;
+
+    if (spiRemaining == 0) {
+        // the last frame is complete, latch it
+        FIO_SET(MAX7219_CS_PORT, (1<<MAX7219_CS_PIN));
+
+        do {
+            if (spiTail == spiHead) {
+                SPI0.INTCTRL = 0;
+                spiActive = false;
+                return;
+            }
+            spiRemaining = spiQueue[spiTail];
+            spiTail = max7219_spiNextPos(spiTail);
+        } while (spiRemaining == 0);
+
+        FIO_CLR(MAX7219_CS_PORT, (1<<MAX7219_CS_PIN));
+    }
+
+    SPI0.DATA = spiQueue[spiTail];
+    spiTail = max7219_spiNextPos(spiTail);
+    spiRemaining--;
+}
+
+ISR(SPI0_INT_vect) {
+    max7219_spiNext();
+}
+
+/**
+ * @brief wait until the SPI made some progress
+ * 
+ * With interrupts disabled we drive the queue ourselves.
+ */
+static inline void max7219_spiWait(void) {
+    if (!(SREG & CPU_I_bm) && (SPI0.INTFLAGS & SPI_IF_bm)) {
+        max7219_spiNext();
+    }
+}
+
+static void max7219_spiQueueByte(uint8_t data) {
+    uint8_t next = max7219_spiNextPos(spiWritePos);
+    while (next == spiTail) {
+        if (spiTail == spiHead) {
+            // the queue is full with the current frame alone, it will never fit
+            return;
+        }
+        // queue is full
+        max7219_spiWait();
+    }
+    spiQueue[spiWritePos] = data;
+    spiWritePos = next;
+}
+
+static void max7219_spiInit(void) {
+    MAX7219_CS_PORT.OUTSET = (1<<MAX7219_CS_PIN);
+
+    SPI0.CTRLB = SPI_SSD_bm | SPI_MODE_0_gc; // no slave select, we drive CS ourselves
+    SPI0.CTRLA = SPI_MASTER_bm | MAX7219_SPI_PRESC | SPI_ENABLE_bm; // MSB first
+}
+
+void max7219_startDataFrame() {
+    spiFrameStart = spiWritePos;
+    max7219_spiQueueByte(0); // the length gets filled in at the end
+}
+
+void max7219_sendDataByte(uint8_t data) {
+    max7219_spiQueueByte(data);
+}
+
+void max7219_endDataFrame(void) {
+    uint8_t len = spiWritePos >= spiFrameStart 
+                ? spiWritePos - spiFrameStart - 1
+                : spiWritePos + MAX7219_SPI_QUEUE_LEN - spiFrameStart - 1;
+    spiQueue[spiFrameStart] = len;
+
+    uint8_t sreg = SREG;
+    cli();
+    spiHead = spiWritePos;
+    if (!spiActive) {
+        spiActive = true;
+        spiRemaining = 0;
+        SPI0.INTCTRL = SPI_IE_bm;
+        max7219_spiNext();
+    }
+    SREG = sreg;
+}
+
+bool max7219_busy(void) {
+    return spiActive;
+}
+
+void max7219_flush(void) {
+    while (spiActive) {
+        max7219_spiWait();
+    }
+}
+
+#else
+
+void max7219_startDataFrame() {
+    FIO_CLR(MAX7219_CLK_PORT,  (1<<MAX7219_CLK_PIN));
+    FIO_CLR(MAX7219_DATA_PORT, (1<<MAX7219_DATA_PIN));
+    FIO_CLR(MAX7219_CS_PORT,   (1<<MAX7219_CS_PIN));
+}
+
+void max7219_sendDataByte(uint8_t data) {
+    FIO_SHIFT_OUT_MSB_FIRST(MAX7219_CLK_PORT, (1<<MAX7219_CLK_PIN), MAX7219_DATA_PORT, (1<<MAX7219_DATA_PIN), data);
+}
+
+void max7219_endDataFrame(void) {
+    FIO_SET(MAX7219_CS_PORT, (1<<MAX7219_CS_PIN));
+}
+
+bool max7219_busy(void) {
+    return false;
+}
+
+void max7219_flush(void) {
+}
+
+#endif
+
+void max7219_sendData(uint8_t cmd, uint8_t data) {
+    max7219_sendDataByte(cmd);
+    max7219_sendDataByte(data);
+}
+
+
+/**
+ * @brief send the same command to all modules in the chain
+ */
+static void max7219_sendToAll(uint8_t modules, uint8_t cmd, uint8_t data) {
+    max7219_startDataFrame();
+    for (uint8_t i=0; i < modules; i++) {
+        max7219_sendData(cmd, data);
+    }
+    max7219_endDataFrame();
+}
 
 void max7219_init(uint8_t numberModules) {
     // set the ports to output
     MAX7219_CLK_PORT.DIRSET  = (1<<MAX7219_CLK_PIN);   
     MAX7219_DATA_PORT.DIRSET = (1<<MAX7219_DATA_PIN);   
     MAX7219_CS_PORT.DIRSET   = (1<<MAX7219_CS_PIN);
+#ifdef MAX7219_USE_SPI
+    max7219_spiInit();
+#endif
+
+    chainModules = numberModules;
 
     // no decode mode
-    max7219_startDataFrame();
-    for (uint8_t i=0; i < numberModules; i++) {
-        max7219_sendData(MAX7219_CMD_DECODE_MODE, MAX7219_DECODE_MODE_NONE);
-    }
-    max7219_endDataFrame();
+    max7219_sendToAll(numberModules, MAX7219_CMD_DECODE_MODE, MAX7219_DECODE_MODE_NONE);
 
     // disable scan limit
-    max7219_startDataFrame();
-    for (uint8_t i=0; i < numberModules; i++) {
-        max7219_sendData(MAX7219_CMD_SCAN_LIMIT, 0x07);
+    max7219_sendToAll(numberModules, MAX7219_CMD_SCAN_LIMIT, 0x07);
+    for (uint8_t i=0; i < MAX7219_MAX_MODULES; i++) {
+        scanDigits[i] = 8;
     }
-    max7219_endDataFrame();
-
 
     // send all zeros to the data register
     for (uint8_t digit=0; digit < 8; digit++) {
-        max7219_startDataFrame();
-        for (uint8_t i=0; i < numberModules; i++) {
-            max7219_sendData(MAX7219_CMD_DIGIT_0 + digit, 0x00);
-        }
-        max7219_endDataFrame();
+        max7219_sendToAll(numberModules, MAX7219_CMD_DIGIT_0 + digit, 0x00);
     }
-
-    // switch display on
-    max7219_startDataFrame();
-    for (uint8_t i=0; i < numberModules; i++) {
-        max7219_sendData(MAX7219_CMD_DISPLAY, MAX7219_DISPLAY_MODE_ON);
+    for (uint16_t i=0; i < sizeof(shadow); i++) {
+        shadow[i] = 0x00;
     }
-    max7219_endDataFrame();
+    shadowModules = numberModules <= MAX7219_MAX_MODULES ? numberModules : 0;
 
+    // switch display on
+    max7219_sendToAll(numberModules, MAX7219_CMD_DISPLAY, MAX7219_DISPLAY_MODE_ON);
 }
 
-void max7219_startDataFrame() {
-    MAX7219_CLK_PORT.OUTCLR  = (1<<MAX7219_CLK_PIN);
-    MAX7219_DATA_PORT.OUTCLR = (1<<MAX7219_DATA_PIN);
-    MAX7219_CS_PORT.OUTCLR   = (1<<MAX7219_CS_PIN);
+void max7219_invalidate(void) {
+    shadowModules = 0;
 }
 
-void max7219_sendDataByte(uint8_t data) {
-   for (uint8_t i = 0; i<8; i++) {
-        MAX7219_CLK_PORT.OUTCLR = (1<<MAX7219_CLK_PIN);
-        if (data & 0x80) {
-            MAX7219_DATA_PORT.OUTSET = (1<<MAX7219_DATA_PIN);
-        }
-        else {
-            MAX7219_DATA_PORT.OUTCLR = (1<<MAX7219_DATA_PIN);
+bool max7219_setLayout(const Max7219Layout* pLayout) {
+    max7219_invalidate();
+
+    if (pLayout == 0) {
+        layoutModules = 0;
+        return true;
+    }
+
+    uint16_t modules = pLayout->modulesPerRow * pLayout->rows;
+    if (modules == 0 || modules > MAX7219_MAX_MODULES) {
+        layoutModules = 0;
+        return false;
+    }
+
+    uint8_t module = 0;
+    for (uint8_t row = 0; row < pLayout->rows; row++) {
+        bool reverse = (pLayout->flags & MAX7219_LAYOUT_SERPENTINE) && (row & 0x01);
+        for (uint8_t col = 0; col < pLayout->modulesPerRow; col++) {
+            uint8_t x = reverse ? pLayout->modulesPerRow - 1 - col : col;
+            layoutOffset[module] = row * 8 * pLayout->modulesPerRow + x;
+            layoutRotation[module] = (pLayout->pRotations != 0 ? pLayout->pRotations[module] : pLayout->rotation) & 0x03;
+            module++;
         }
-        MAX7219_CLK_PORT.OUTSET = (1<<MAX7219_CLK_PIN);
-        data = data << 1;
     }
-}
+    layoutWidthBytes = pLayout->modulesPerRow;
+    layoutModules = modules;
 
-void max7219_sendData(uint8_t cmd, uint8_t data) {
-    max7219_sendDataByte(cmd);
-    max7219_sendDataByte(data);
+    return true;
 }
 
-void max7219_endDataFrame(void) {
-    MAX7219_CS_PORT.OUTSET   = (1<<MAX7219_CS_PIN);
+static uint8_t max7219_reverseBits(uint8_t data) {
+    data = (data & 0xF0) >> 4 | (data & 0x0F) << 4;
+    data = (data & 0xCC) >> 2 | (data & 0x33) << 2;
+    return (data & 0xAA) >> 1 | (data & 0x55) << 1;
 }
 
+/**
+ * @brief the content of a single row of a module in the layout
+ */
+static uint8_t max7219_layoutRow(FrameBuffer* pFrameBuffer, uint8_t module, uint8_t row) {
+    uint8_t* pBlock = pFrameBuffer->buffer + layoutOffset[module];
+    uint8_t rotation = layoutRotation[module];
+
+    if (rotation == MAX7219_ROTATE_0) {
+        return pBlock[row * layoutWidthBytes];
+    }
+    if (rotation == MAX7219_ROTATE_180) {
+        return max7219_reverseBits(pBlock[(7 - row) * layoutWidthBytes]);
+    }
+
+    // the row gets built from a column of the block
+    uint8_t srcMask = rotation == MAX7219_ROTATE_90 ? 0x80 >> row : 0x01 << row;
+    uint8_t data = 0;
+    for (uint8_t i = 0; i < 8; i++) {
+        data <<= 1;
+        if (*pBlock & srcMask) {
+            data |= 0x01;
+        }
+        pBlock += layoutWidthBytes;
+    }
+    // 90 degree reads the column from bottom to top
+    return rotation == MAX7219_ROTATE_90 ? max7219_reverseBits(data) : data;
+}
 
 void max7219_renderData(FrameBuffer* pFrameBuffer) {
-    // switch display off to avoid flickering effects
     uint8_t modules = pFrameBuffer->bufferLen / 8;
-    max7219_startDataFrame();
-    for (uint8_t i=0; i < modules; i++) {
-        max7219_sendData(MAX7219_CMD_DISPLAY, MAX7219_DISPLAY_MODE_OFF);
-    }
-    max7219_endDataFrame();
+
+    // the shadow is only valid for the very same chain
+    bool diff = modules <= MAX7219_MAX_MODULES && modules == shadowModules;
+
+    // the layout only gets applied to a frame buffer of the right size
+    bool mapped = modules == layoutModules && pFrameBuffer->widthBytes == layoutWidthBytes;
+    uint8_t rowData[MAX7219_MAX_MODULES];
+
+#ifdef MAX7219_BLANK_ON_RENDER
+    // switch display off to avoid flickering effects
+    max7219_sendToAll(modules, MAX7219_CMD_DISPLAY, MAX7219_DISPLAY_MODE_OFF);
+#endif
 
     uint8_t* pBufferPos = pFrameBuffer->buffer;
+    uint8_t* pShadowPos = shadow;
     for (uint8_t row = 0; row < 8; row++) {
-        max7219_startDataFrame();
-        for (uint8_t module = 0; module < modules; module++) {
-            max7219_sendData(MAX7219_CMD_DIGIT_0 + row, *pBufferPos++);
+        if (mapped) {
+            for (uint8_t module = 0; module < modules; module++) {
+                rowData[module] = max7219_layoutRow(pFrameBuffer, module, row);
+            }
+            pBufferPos = rowData;
+        }
+
+        bool rowChanged = !diff;
+        for (uint8_t module = 0; module < modules && !rowChanged; module++) {
+            rowChanged = pBufferPos[module] != pShadowPos[module];
+        }
+
+        if (rowChanged) {
+            // modules which already show the right data just pass the row through
+            max7219_startDataFrame();
+            for (uint8_t module = 0; module < modules; module++) {
+                if (!diff || pBufferPos[module] != pShadowPos[module]) {
+                    max7219_sendData(MAX7219_CMD_DIGIT_0 + row, pBufferPos[module]);
+                }
+                else {
+                    max7219_sendData(MAX7219_CMD_NO_OP, 0x00);
+                }
+            }
+            max7219_endDataFrame();
+        }
+
+        if (modules <= MAX7219_MAX_MODULES) {
+            for (uint8_t module = 0; module < modules; module++) {
+                pShadowPos[module] = pBufferPos[module];
+            }
+            pShadowPos += modules;
         }
-        max7219_endDataFrame();
+        pBufferPos += modules;
     }
+    shadowModules = modules <= MAX7219_MAX_MODULES ? modules : 0;
 
+#ifdef MAX7219_BLANK_ON_RENDER
     // switch display on again
+    max7219_sendToAll(modules, MAX7219_CMD_DISPLAY, MAX7219_DISPLAY_MODE_ON);
+#endif
+}
+
+
+void max7219_sendToModule(uint8_t module, uint8_t cmd, uint8_t data) {
     max7219_startDataFrame();
-    for (uint8_t i=0; i < modules; i++) {
-        max7219_sendData(MAX7219_CMD_DISPLAY, MAX7219_DISPLAY_MODE_ON);
+    for (uint8_t i=0; i < chainModules; i++) {
+        if (i == module) {
+            max7219_sendData(cmd, data);
+        }
+        else {
+            max7219_sendData(MAX7219_CMD_NO_OP, 0x00);
+        }
     }
     max7219_endDataFrame();
+}
+
+void max7219_setDecodeMode(uint8_t module, uint8_t decodeMode) {
+    max7219_sendToModule(module, MAX7219_CMD_DECODE_MODE, decodeMode);
+}
+
+void max7219_setScanLimit(uint8_t module, uint8_t digits) {
+    if (digits < 1 || digits > 8) {
+        return;
+    }
+    if (module < MAX7219_MAX_MODULES) {
+        scanDigits[module] = digits;
+    }
+    max7219_sendToModule(module, MAX7219_CMD_SCAN_LIMIT, digits - 1);
+}
 
+void max7219_setDigit(uint8_t module, uint8_t digit, uint8_t value) {
+    if (digit > 7) {
+        // would hit the control registers
+        return;
+    }
+    if (shadowModules != 0 && shadowModules == chainModules && module < shadowModules) {
+        // the digit registers are the very same as the matrix rows
+        uint8_t* pShadow = &shadow[digit * shadowModules + module];
+        if (*pShadow == value) {
+            return;
+        }
+        *pShadow = value;
+    }
+    max7219_sendToModule(module, MAX7219_CMD_DIGIT_0 + digit, value);
 }
 
+void max7219_printNumber(uint8_t module, int32_t value, uint8_t decimals) {
+    uint8_t digits = module < MAX7219_MAX_MODULES ? scanDigits[module] : 8;
+    uint8_t codes[8];
 
+    bool negative = value < 0;
+    uint32_t rest = negative ? -(uint32_t) value : (uint32_t) value;
+
+    for (uint8_t pos = 0; pos < digits; pos++) {
+        if (rest != 0 || pos <= decimals) {
+            codes[pos] = rest % 10;
+            rest = rest / 10;
+            if (decimals > 0 && pos == decimals) {
+                codes[pos] |= MAX7219_CODEB_DP;
+            }
+        }
+        else if (negative) {
+            codes[pos] = MAX7219_CODEB_MINUS;
+            negative = false;
+        }
+        else {
+            codes[pos] = MAX7219_CODEB_BLANK;
+        }
+    }
+
+    bool overflow = rest != 0 || negative;
+    for (uint8_t pos = 0; pos < digits; pos++) {
+        max7219_setDigit(module, pos, overflow ? MAX7219_CODEB_MINUS : codes[pos]);
+    }
+}
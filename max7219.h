@@ -24,34 +24,110 @@
  * I use bit-banging instead of hw SPI to be more flexible with the IO pins to use.
  * There is not that much of a speed difference at those low speeds and the MAX7219
  * doesn't use a fully SPI compat interface anyway.
+ * 
+ * For long chains define MAX7219_USE_SPI to use the hardware SPI0 instead.
+ * The frames then get queued and shifted out by the SPI interrupt,
+ * so rendering returns right away. In that case MAX7219_CLK_* and MAX7219_DATA_*
+ * must point to the SCK and MOSI pins of SPI0, the CS pin can be any other pin.
+ * The queue is sized for MAX7219_MAX_MODULES, longer chains don't work with SPI.
+ * Interrupts must be enabled, otherwise the driver polls the SPI itself.
  */
 
 #include <avr/io.h>
+#include <stdbool.h>
 
 #include "gfx/frameBuffer.h"
 
 
+#ifdef MAX7219_USE_SPI
+    // default pinout of SPI0 is PA3 SCK and PA1 MOSI, CS must not be one of the SPI pins
+    #define MAX7219_DEFAULT_CLK_PIN  PIN3
+    #define MAX7219_DEFAULT_DATA_PIN PIN1
+    #define MAX7219_DEFAULT_CS_PIN   PIN7
+#else
+    #define MAX7219_DEFAULT_CLK_PIN  PIN3
+    #define MAX7219_DEFAULT_DATA_PIN PIN2
+    #define MAX7219_DEFAULT_CS_PIN   PIN1
+#endif
+
 #ifndef MAX7219_CLK_PORT
     #define MAX7219_CLK_PORT PORTA
 #endif
 #ifndef MAX7219_CLK_PIN
-    #define MAX7219_CLK_PIN PIN3
+    #define MAX7219_CLK_PIN MAX7219_DEFAULT_CLK_PIN
 #endif
 
 #ifndef MAX7219_DATA_PORT
     #define MAX7219_DATA_PORT PORTA
 #endif
 #ifndef MAX7219_DATA_PIN
-    #define MAX7219_DATA_PIN PIN2
+    #define MAX7219_DATA_PIN MAX7219_DEFAULT_DATA_PIN
 #endif
 
 #ifndef MAX7219_CS_PORT
     #define MAX7219_CS_PORT PORTA
 #endif
 #ifndef MAX7219_CS_PIN
-    #define MAX7219_CS_PIN PIN1
+    #define MAX7219_CS_PIN MAX7219_DEFAULT_CS_PIN
+#endif
+
+// maximum number of modules the render shadow and the layout are sized for, max 255.
+// Longer chains get rendered without skipping unchanged rows.
+#ifndef MAX7219_MAX_MODULES
+    #define MAX7219_MAX_MODULES 8
 #endif
 
+// rotation of a module, the 8x8 block gets turned clockwise before it is sent
+#define MAX7219_ROTATE_0            0x00
+#define MAX7219_ROTATE_90           0x01
+#define MAX7219_ROTATE_180          0x02
+#define MAX7219_ROTATE_270          0x03
+
+// every 2nd row of modules is wired from right to left
+#define MAX7219_LAYOUT_SERPENTINE   0x01
+
+/**
+ * @brief how the modules of a chain are arranged
+ * 
+ * The modules are counted in the order their data gets sent,
+ * the same order as with a single row of modules in the frame buffer.
+ * They fill the rows of the wall from left to right, top to bottom.
+ * With MAX7219_LAYOUT_SERPENTINE the odd rows get filled from right to left.
+ * Modules of those rows usually are mounted upside down, use
+ * MAX7219_ROTATE_180 for them.
+ */
+typedef struct {
+    uint8_t modulesPerRow;
+    uint8_t rows;
+    uint8_t flags;              // MAX7219_LAYOUT_* bits
+    uint8_t rotation;           // MAX7219_ROTATE_* of all modules if pRotations is 0
+    const uint8_t* pRotations;  // MAX7219_ROTATE_* per module in chain order or 0
+} Max7219Layout;
+
+#ifdef MAX7219_USE_SPI
+    // the SPI clock, the MAX7219 can do up to 10MHz
+    #ifndef MAX7219_SPI_PRESC
+        #define MAX7219_SPI_PRESC SPI_PRESC_DIV16_gc
+    #endif
+
+    // queue for the SPI transfer, room for all 8 rows of a render by default
+    // so max7219_renderData doesn't need to wait, capped for long chains.
+    // Each row is a length byte plus 2 bytes per module, the ring buffer keeps one slot free.
+    #ifndef MAX7219_SPI_QUEUE_LEN
+        #define MAX7219_SPI_QUEUE_LEN \
+            ((MAX7219_MAX_MODULES * 2 + 1) * 8 + 1 > 255 ? 255 : (MAX7219_MAX_MODULES * 2 + 1) * 8 + 1)
+    #endif
+    #if MAX7219_SPI_QUEUE_LEN > 255
+        #error "MAX7219_SPI_QUEUE_LEN must not exceed 255"
+    #endif
+    #if MAX7219_SPI_QUEUE_LEN < MAX7219_MAX_MODULES * 2 + 2
+        // a row only gets sent once it is complete, so a bigger one would never fit
+        #error "MAX7219_SPI_QUEUE_LEN must hold a whole row of MAX7219_MAX_MODULES"
+    #endif
+#endif
+
+// define MAX7219_BLANK_ON_RENDER to switch the display off while a frame gets rendered
+
 #define MAX7219_CMD_NO_OP   0x00
 #define MAX7219_CMD_DIGIT_0 0x01
 #define MAX7219_CMD_DIGIT_1 0x02
@@ -72,6 +148,15 @@
 #define MAX7219_DECODE_MODE_CODEB4  0x0F
 #define MAX7219_DECODE_MODE_CODEB7  0xFF
 
+// Code-B font of the decode mode, digits 0..9 are just their value
+#define MAX7219_CODEB_MINUS         0x0A
+#define MAX7219_CODEB_E             0x0B
+#define MAX7219_CODEB_H             0x0C
+#define MAX7219_CODEB_L             0x0D
+#define MAX7219_CODEB_P             0x0E
+#define MAX7219_CODEB_BLANK         0x0F
+#define MAX7219_CODEB_DP            0x80 // OR this to show the decimal point
+
 #define MAX7219_DISPLAY_MODE_ON     0x01
 #define MAX7219_DISPLAY_MODE_OFF    0x00
 
@@ -110,6 +195,18 @@ void max7219_startDataFrame(void);
 void max7219_sendData(uint8_t cmd, uint8_t data);
 void max7219_endDataFrame(void);
 
+/**
+ * @brief whether there is still data being shifted out
+ * 
+ * Always false for the bit-banging version.
+ */
+bool max7219_busy(void);
+
+/**
+ * @brief wait until all queued frames are shifted out
+ */
+void max7219_flush(void);
+
 /**
  * @brief render the display data in the buffer
  * 
@@ -118,9 +215,89 @@ void max7219_endDataFrame(void);
  * The topleft pixel is the MSB of the first byte.
  * The first byte is the first row of the topleft matrix.
  * 
+ * Only rows which differ from the previously rendered frame get sent.
+ * Modules which already show the right row get a NO_OP.
+ * 
+ * If a layout got set via #max7219_setLayout and the frame buffer matches it,
+ * the modules get mapped to their place in the wall.
+ * 
  * @param pBuffer pointer to the display buffer
  */
 void max7219_renderData(FrameBuffer* pBuffer);
 
+/**
+ * @brief set how the modules of a 2 dimensional wall are wired
+ * 
+ * The frame buffer must then be modulesPerRow*8 pixels wide
+ * and rows*8 pixels high.
+ * The mapping gets calculated once, rendering just looks it up.
+ * 
+ * @param pLayout the layout or 0 for a single row without rotation
+ * @return false if the layout has more than MAX7219_MAX_MODULES modules
+ */
+bool max7219_setLayout(const Max7219Layout* pLayout);
+
+/**
+ * @brief forget what the modules show
+ * 
+ * The next #max7219_renderData will send all rows.
+ * Use this after sending digit data directly via #max7219_sendData.
+ */
+void max7219_invalidate(void);
+
+
+/**
+ * @brief send a command to a single module of the chain
+ * 
+ * All other modules get a NO_OP.
+ * 
+ * @param module 0-based position, 0 is the first module in the frame buffer
+ * @param cmd the command
+ * @param data the actual data information
+ */
+void max7219_sendToModule(uint8_t module, uint8_t cmd, uint8_t data);
+
+/**
+ * @brief set the decode mode of a single module
+ * 
+ * For 7-segment modules use e.g. MAX7219_DECODE_MODE_CODEB7 to let
+ * the chip decode the digits itself.
+ * 
+ * @param module 0-based position in the chain
+ * @param decodeMode one of the MAX7219_DECODE_MODE_* values
+ */
+void max7219_setDecodeMode(uint8_t module, uint8_t decodeMode);
+
+/**
+ * @brief set the number of digits a module scans
+ * 
+ * @param module 0-based position in the chain
+ * @param digits 1..8
+ */
+void max7219_setScanLimit(uint8_t module, uint8_t digits);
+
+/**
+ * @brief set the register of a single digit
+ * 
+ * Only gets sent if the digit actually changed.
+ * 
+ * @param module 0-based position in the chain
+ * @param digit 0-based digit 0..7, 0 is usually the rightmost one, others get ignored
+ * @param value a MAX7219_CODEB_* value or 0..9 in Code-B decode mode, the segments otherwise
+ */
+void max7219_setDigit(uint8_t module, uint8_t digit, uint8_t value);
+
+/**
+ * @brief show a right aligned decimal number on a module in Code-B decode mode
+ * 
+ * The number gets split into digits and handed to the chip's decoder,
+ * only changed digits get sent.
+ * If the number does not fit into the scanned digits all digits show a '-'.
+ * 
+ * @param module 0-based position in the chain
+ * @param value the number, e.g. 1234 with 2 decimals shows 12.34
+ * @param decimals number of digits after the decimal point, 0 for none
+ */
+void max7219_printNumber(uint8_t module, int32_t value, uint8_t decimals);
 
 #endif
\ No newline at end of file
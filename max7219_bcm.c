@@ -0,0 +1,84 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "max7219_bcm.h"
+#include "max7219.h"
+
+#include <avr/interrupt.h>
+
+
+static GrayFrameBuffer* pBcmFrameBuffer;
+static uint16_t bcmSlotCounts;
+static uint8_t bcmPlane;
+static volatile uint16_t bcmMaxRenderCounts;
+
+
+void max7219_bcm_start(GrayFrameBuffer* pGrayFrameBuffer, uint16_t slotCounts) {
+    pBcmFrameBuffer = pGrayFrameBuffer;
+    bcmSlotCounts = slotCounts;
+    bcmPlane = 0;
+    bcmMaxRenderCounts = 0;
+
+    MAX7219_BCM_TIMER.CTRLA = 0;
+    MAX7219_BCM_TIMER.CTRLB = TCB_CNTMODE_INT_gc; // periodic interrupt
+    MAX7219_BCM_TIMER.CCMP = slotCounts;
+    MAX7219_BCM_TIMER.CNT = 0;
+    MAX7219_BCM_TIMER.INTFLAGS = TCB_CAPT_bm;
+    MAX7219_BCM_TIMER.INTCTRL = TCB_CAPT_bm;
+    MAX7219_BCM_TIMER.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+}
+
+void max7219_bcm_stop(void) {
+    MAX7219_BCM_TIMER.INTCTRL = 0;
+    MAX7219_BCM_TIMER.CTRLA = 0;
+}
+
+ISR(MAX7219_BCM_TIMER_vect) {
+    MAX7219_BCM_TIMER.INTFLAGS = TCB_CAPT_bm;
+
+    max7219_renderData(&pBcmFrameBuffer->planes[bcmPlane]);
+
+    // the plane just rendered stays for its binary weight
+    MAX7219_BCM_TIMER.CCMP = bcmSlotCounts << bcmPlane;
+    bcmPlane = bcmPlane + 1 < GRAY_PLANES ? bcmPlane + 1 : 0;
+
+    // the counter restarted when the interrupt fired
+    uint16_t used = MAX7219_BCM_TIMER.CNT;
+    if (used > bcmMaxRenderCounts) {
+        bcmMaxRenderCounts = used;
+    }
+}
+
+void max7219_bcm_getStats(Max7219BcmStats* pStats) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t maxRenderCounts = bcmMaxRenderCounts;
+    SREG = sreg;
+
+    pStats->slotCounts = bcmSlotCounts;
+    pStats->maxRenderCounts = maxRenderCounts;
+
+    uint32_t load = bcmSlotCounts > 0 ? (uint32_t) maxRenderCounts * 100 / bcmSlotCounts : 0;
+    pStats->loadPercent = load > 0xFF ? 0xFF : load;
+
+    uint32_t cycleCounts = (uint32_t) bcmSlotCounts * (GRAY_LEVELS - 1);
+    pStats->cyclesPerSecond = cycleCounts > 0 ? MAX7219_BCM_TIMER_HZ / cycleCounts : 0;
+
+    // the render time grows linear with the number of modules
+    uint8_t modules = pBcmFrameBuffer != 0 ? pBcmFrameBuffer->planes[0].bufferLen / 8 : 0;
+    uint32_t maxModules = maxRenderCounts > 0 ? (uint32_t) modules * bcmSlotCounts / maxRenderCounts : 0;
+    pStats->maxModules = maxModules > 0xFF ? 0xFF : maxModules;
+}
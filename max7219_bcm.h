@@ -0,0 +1,81 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __MAX_7219_BCM_H__
+    #define __MAX_7219_BCM_H__
+
+/**
+ * @brief grayscale for MAX7219 matrix modules via binary code modulation
+ * @author Mark Struberg (struberg@apache.org)
+ * 
+ * The MAX7219 only knows on and off per pixel.
+ * A timer interrupt cycles through the bitplanes of a GrayFrameBuffer
+ * and shows each plane for a time proportional to its binary weight:
+ * plane 0 for 1 slot, plane 1 for 2 slots, etc.
+ * 
+ * Switching planes uses #max7219_renderData, so only rows which differ
+ * between the planes get sent and unchanged modules get a NO_OP.
+ * Pixels which are fully on or off in all planes cost nothing.
+ * 
+ * Rendering a plane must finish well within a single slot.
+ * Use #max7219_bcm_getStats to see how much of the slot it takes.
+ */
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#include "gfx/grayFrameBuffer.h"
+
+#ifndef MAX7219_BCM_TIMER
+    #define MAX7219_BCM_TIMER TCB1
+#endif
+#ifndef MAX7219_BCM_TIMER_vect
+    #define MAX7219_BCM_TIMER_vect TCB1_INT_vect
+#endif
+
+// the timer runs at F_CPU / 2
+#define MAX7219_BCM_TIMER_HZ (F_CPU / 2)
+
+typedef struct {
+    uint16_t slotCounts;        // timer counts of the shortest (plane 0) slot
+    uint16_t maxRenderCounts;   // longest plane switch seen so far, in timer counts
+    uint8_t loadPercent;        // maxRenderCounts relative to a slot
+    uint16_t cyclesPerSecond;   // full grayscale cycles per second, > 100 is flicker free
+    uint8_t maxModules;         // estimated number of modules which still fit into a slot
+} Max7219BcmStats;
+
+/**
+ * @brief start cycling the bitplanes
+ * 
+ * Don't call #max7219_renderData while the grayscale refresh is running.
+ * 
+ * @param pGrayFrameBuffer the planes must have the size of the module chain
+ * @param slotCounts on-time of plane 0 in timer counts, see MAX7219_BCM_TIMER_HZ
+ */
+void max7219_bcm_start(GrayFrameBuffer* pGrayFrameBuffer, uint16_t slotCounts);
+
+/**
+ * @brief stop cycling, the last shown plane stays on the display
+ */
+void max7219_bcm_stop(void);
+
+/**
+ * @brief cycle budget report
+ * 
+ * @param pStats gets filled with the measured values
+ */
+void max7219_bcm_getStats(Max7219BcmStats* pStats);
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "max7219_marquee.h"
+#include "max7219.h"
+#include "systick.h"
+#include "gfx/tile_8x8.h"
+#include "gfx/font_proportional.h"
+
+
+struct marquee_state {
+    struct pt pt;
+    FrameBuffer* pFrameBuffer;
+    bool running;
+
+    const char* text;
+    uint8_t textPos;
+
+    /**
+     * @brief the pre-rendered columns of the current glyph plus spacing
+     * The MSB is the top pixel.
+     */
+    uint8_t columns[9];
+    uint8_t columnCount;
+    uint8_t columnPos;
+
+    uint8_t frameTicks;
+    uint32_t lastFrame; // tick of the last frame
+};
+
+static struct marquee_state tsMarquee = {0,};
+
+
+/**
+ * @brief render the next glyph of the text into the column buffer
+ */
+static void marquee_loadGlyph(void) {
+    tsMarquee.columnPos = 0;
+
+    if (tsMarquee.text[tsMarquee.textPos] == 0) {
+        // blank gap, then start over
+        for (uint8_t i = 0; i < MARQUEE_END_GAP; i++) {
+            tsMarquee.columns[i] = 0x00;
+        }
+        tsMarquee.columnCount = MARQUEE_END_GAP;
+        tsMarquee.textPos = 0;
+        return;
+    }
+
+    Tile tile;
+    fontp_loadCharTile(tsMarquee.text[tsMarquee.textPos++], &tile);
+    uint8_t width = tile_getWidth(&tile);
+
+    for (uint8_t x = 0; x < width; x++) {
+        uint8_t column = 0;
+        for (uint8_t y = 0; y < 8; y++) {
+            if (tile.bytes[y] & (0x80 >> x)) {
+                column |= 0x80 >> y;
+            }
+        }
+        tsMarquee.columns[x] = column;
+    }
+    tsMarquee.columns[width] = 0x00; // spacing
+    tsMarquee.columnCount = width + 1;
+}
+
+void marquee_start(FrameBuffer* pFrameBuffer, const char* text, uint8_t frameTicks) {
+    tsMarquee.pFrameBuffer = pFrameBuffer;
+    tsMarquee.text = text;
+    tsMarquee.textPos = 0;
+    tsMarquee.frameTicks = frameTicks;
+    tsMarquee.lastFrame = systick_ticks();
+    marquee_loadGlyph();
+    tsMarquee.running = true;
+}
+
+void marquee_stop(void) {
+    tsMarquee.running = false;
+}
+
+void marquee_step(void) {
+    if (tsMarquee.columnPos >= tsMarquee.columnCount) {
+        marquee_loadGlyph();
+    }
+    uint8_t column = tsMarquee.columns[tsMarquee.columnPos++];
+
+    FrameBuffer* pFrameBuffer = tsMarquee.pFrameBuffer;
+    uint8_t* pRow = pFrameBuffer->buffer;
+    for (uint8_t y = 0; y < 8 && y < pFrameBuffer->heigth; y++) {
+        // shift from the right to the left, carrying the leftmost pixel over
+        uint8_t carry = (column & (0x80 >> y)) ? 0x01 : 0x00;
+        for (uint16_t x = pFrameBuffer->widthBytes; x > 0; x--) {
+            uint8_t val = pRow[x-1];
+            pRow[x-1] = (val << 1) | carry;
+            carry = val >> 7;
+        }
+        pRow += pFrameBuffer->widthBytes;
+    }
+}
+
+PT_THREAD(task_marquee(void))
+{
+    PT_BEGIN(&tsMarquee.pt);
+
+    PT_WAIT_UNTIL(&tsMarquee.pt, tsMarquee.running && systick_ticks() - tsMarquee.lastFrame >= tsMarquee.frameTicks);
+    tsMarquee.lastFrame = systick_ticks();
+
+    marquee_step();
+    max7219_renderData(tsMarquee.pFrameBuffer);
+
+    PT_END(&tsMarquee.pt);
+}
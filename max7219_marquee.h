@@ -0,0 +1,71 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __MAX_7219_MARQUEE_H__
+    #define __MAX_7219_MARQUEE_H__
+
+/**
+ * @brief smooth scrolling text for chained MAX7219 8x8 matrix modules
+ * @author Mark Struberg (struberg@apache.org)
+ * 
+ * The text gets rendered one glyph at a time into a small column buffer
+ * using the proportional 8x8 font.
+ * Each frame shifts the rows of the frame buffer one pixel to the left,
+ * carrying the MSB over to the module on the left, and feeds in the next column.
+ * Thus the frame buffer only needs to be as wide as the display,
+ * no matter how long the text is.
+ */
+
+#include <stdbool.h>
+
+#include "pt.h"
+#include "gfx/frameBuffer.h"
+
+// blank columns after the end of the text before it starts over, max 9
+#ifndef MARQUEE_END_GAP
+    #define MARQUEE_END_GAP 8
+#endif
+
+/**
+ * @brief start scrolling the given text
+ * 
+ * The text is not copied, it must stay valid while the marquee is running.
+ * The text loops endlessly.
+ * 
+ * @param pFrameBuffer the frame buffer of the display, the top 8 rows get used
+ * @param text zero terminated
+ * @param frameTicks task ticks between two frames
+ */
+void marquee_start(FrameBuffer* pFrameBuffer, const char* text, uint8_t frameTicks);
+
+/**
+ * @brief stop scrolling, the current frame stays on the display
+ */
+void marquee_stop(void);
+
+/**
+ * @brief shift the frame buffer by a single pixel
+ * 
+ * This does not render the frame buffer.
+ * Only needed if the frames get driven by the application instead of #task_marquee.
+ */
+void marquee_step(void);
+
+/**
+ * @brief push a new frame to the MAX7219 every frameTicks
+ */
+PT_THREAD(task_marquee(void));
+
+#endif
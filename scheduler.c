@@ -0,0 +1,207 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "scheduler.h"
+
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+// only linked in if the application uses them
+bool usart_tx_busy(void) __attribute__((weak));
+bool i2c_busy(void) __attribute__((weak));
+
+
+static const SchedulerTask* pSchedTasks;
+static uint8_t schedTaskCount = 0;
+
+// task indexes sorted by priority
+static uint8_t schedOrder[SCHEDULER_MAX_TASKS];
+
+// ticks until each task is due again, only touched by the ISR
+static uint16_t schedCountdown[SCHEDULER_MAX_TASKS];
+
+// one bit per task which is due, set by the ISR
+static volatile uint8_t schedReady = 0;
+
+// one bit per task which yielded and wants to continue right away
+static uint8_t schedPending = 0;
+
+static volatile uint16_t schedOverruns[SCHEDULER_MAX_TASKS];
+
+// the tick callback which was registered before the scheduler took over
+static void (*schedPrevTick)(void) = 0;
+
+// whether we just woke up from sleep and the next ready task should get measured
+static bool schedWoken = false;
+static uint16_t schedMaxWakeLatency = 0;
+
+
+/**
+ * @brief called from the systick ISR on every tick
+ */
+static void scheduler_tick(void) {
+    if (schedPrevTick != 0) {
+        (*schedPrevTick)();
+    }
+
+    for (uint8_t i = 0; i < schedTaskCount; i++) {
+        if (--schedCountdown[i] == 0) {
+            uint16_t period = pSchedTasks[i].period;
+            schedCountdown[i] = period > 0 ? period : 1;
+
+            uint8_t bit = 1 << i;
+            if (schedReady & bit) {
+                schedOverruns[i]++;
+            }
+            schedReady |= bit;
+        }
+    }
+}
+
+void scheduler_init(const SchedulerTask* pTasks, uint8_t taskCount) {
+    pSchedTasks = pTasks;
+    schedTaskCount = taskCount < SCHEDULER_MAX_TASKS ? taskCount : SCHEDULER_MAX_TASKS;
+
+    for (uint8_t i = 0; i < schedTaskCount; i++) {
+        schedCountdown[i] = pTasks[i].phase + 1;
+        schedOverruns[i] = 0;
+
+        // insertion sort by priority, same priorities stay in table order
+        uint8_t pos = i;
+        while (pos > 0 && pTasks[schedOrder[pos - 1]].priority > pTasks[i].priority) {
+            schedOrder[pos] = schedOrder[pos - 1];
+            pos--;
+        }
+        schedOrder[pos] = i;
+    }
+    schedReady = 0;
+    schedPending = 0;
+
+    void (*prevTick)(void) = systick_getTickCallback();
+    if (prevTick != scheduler_tick) {
+        // don't chain ourselves if scheduler_init gets called again
+        schedPrevTick = prevTick;
+    }
+    systick_setTickCallback(scheduler_tick);
+    systick_init();
+
+#if SCHEDULER_SLEEP_MODE == SLEEP_MODE_STANDBY
+    TASK_TIMER.CTRLA |= TCB_RUNSTDBY_bm;
+#endif
+}
+
+/**
+ * @brief run a single task and remember whether it yielded
+ */
+static void scheduler_call(uint8_t taskIndex) {
+    uint8_t bit = 1 << taskIndex;
+
+    uint8_t sreg = SREG;
+    cli();
+    schedReady &= ~bit;
+    SREG = sreg;
+
+    if ((*pSchedTasks[taskIndex].task)() == PT_YIELDED) {
+        schedPending |= bit;
+    }
+    else {
+        schedPending &= ~bit;
+    }
+}
+
+bool scheduler_dispatch(void) {
+    // due tasks first, so a yielding task can't delay them
+    for (uint8_t i = 0; i < schedTaskCount; i++) {
+        if (schedReady & (1 << schedOrder[i])) {
+            if (schedWoken) {
+                // the tick ISR fired at CNT 0, so CNT is the time since the wake up
+                uint16_t latency = TASK_TIMER.CNT;
+                if (latency > schedMaxWakeLatency) {
+                    schedMaxWakeLatency = latency;
+                }
+                schedWoken = false;
+            }
+            scheduler_call(schedOrder[i]);
+            return true;
+        }
+    }
+    for (uint8_t i = 0; i < schedTaskCount; i++) {
+        if (schedPending & (1 << schedOrder[i])) {
+            scheduler_call(schedOrder[i]);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief sleep until the next interrupt if there is really nothing to do
+ */
+static void scheduler_idle(void) {
+#ifndef SCHEDULER_NO_SLEEP
+    if ((usart_tx_busy && usart_tx_busy()) || (i2c_busy && i2c_busy())) {
+        return;
+    }
+
+    set_sleep_mode(SCHEDULER_SLEEP_MODE);
+    cli();
+    // an ISR might have made a task ready since the last dispatch
+    if (schedReady == 0 && schedPending == 0) {
+        sleep_enable();
+        // the instruction after sei is always executed before any ISR,
+        // so a tick can't sneak in between and keep us sleeping for a whole period
+        sei();
+        sleep_cpu();
+        sleep_disable();
+        schedWoken = true;
+    }
+    else {
+        sei();
+    }
+#endif
+}
+
+void scheduler_run(void) {
+    while (1) {
+        if (!scheduler_dispatch()) {
+            scheduler_idle();
+        }
+    }
+}
+
+uint16_t scheduler_getOverruns(uint8_t taskIndex) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t overruns = taskIndex < schedTaskCount ? schedOverruns[taskIndex] : 0;
+    SREG = sreg;
+    return overruns;
+}
+
+void scheduler_resetOverruns(void) {
+    uint8_t sreg = SREG;
+    cli();
+    for (uint8_t i = 0; i < schedTaskCount; i++) {
+        schedOverruns[i] = 0;
+    }
+    SREG = sreg;
+}
+
+uint16_t scheduler_getMaxWakeLatency(void) {
+    return schedMaxWakeLatency;
+}
+
+void scheduler_resetMaxWakeLatency(void) {
+    schedMaxWakeLatency = 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __SCHEDULER_H__
+    #define __SCHEDULER_H__
+
+/**
+ * @file scheduler.h
+ * @author Mark Struberg (struberg@apache.org)
+ * @brief a small scheduler for the protothread tasks
+ * 
+ * The tasks get defined in a static table, each with its period and phase in TASK ticks
+ * and a priority. The systick ISR marks the due tasks as ready,
+ * the dispatch loop then only calls the tasks which are ready,
+ * the one with the highest priority first.
+ * 
+ * A task which returns PT_YIELDED is in the middle of something,
+ * e.g. waiting a few µs for the LCD, and gets called again as soon as
+ * no due task is waiting.
+ * A task which returns PT_WAITING or PT_ENDED gets called again in its next period.
+ * 
+ * If a task is still ready when its next period starts it did not get
+ * dispatched in time and the overrun counter of the task gets incremented.
+ * 
+ * If no task is ready or pending and neither the USART nor the I2C bus is busy,
+ * scheduler_run puts the CPU to sleep until the next interrupt.
+ * The default SLEEP_MODE_IDLE keeps the TASK_TIMER running, so the displays
+ * get refreshed on the same ticks as without sleeping.
+ * 
+ * The scheduler owns the systick tick callback. A callback registered
+ * before #scheduler_init still gets called on every tick,
+ * registering one afterwards would stop the dispatching.
+ * With SLEEP_MODE_STANDBY the TASK_TIMER gets switched to RUNSTDBY,
+ * but only a pin change or an USART start of frame can wake up peripherals besides that.
+ * 
+ * Example:
+ * static const SchedulerTask tasks[] = {
+ *     {task_lcd,            1, 0, 1},
+ *     {task_ssd1306_power, 20, 5, 2},
+ * };
+ * scheduler_init(tasks, sizeof(tasks) / sizeof(SchedulerTask));
+ * sei();
+ * scheduler_run();
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pt.h"
+#include "systick.h"
+
+// max number of tasks, each task is a bit in the ready bitmap
+#define SCHEDULER_MAX_TASKS 8
+
+// sleep mode when there is nothing to do, define SCHEDULER_NO_SLEEP to keep spinning
+#ifndef SCHEDULER_SLEEP_MODE
+    #define SCHEDULER_SLEEP_MODE SLEEP_MODE_IDLE
+#endif
+
+typedef struct {
+    char (*task)(void);  // the PT_THREAD function
+    uint16_t period;     // TASK ticks between two calls, 0 and 1 mean every tick
+    uint16_t phase;      // TASK ticks of delay to spread tasks with the same period
+    uint8_t priority;    // 0 is the highest priority
+} SchedulerTask;
+
+/**
+ * @brief set up the scheduler with the given tasks
+ * 
+ * Also starts the systick.
+ * 
+ * @param pTasks the task table, must stay valid
+ * @param taskCount number of tasks, max SCHEDULER_MAX_TASKS
+ */
+void scheduler_init(const SchedulerTask* pTasks, uint8_t taskCount);
+
+/**
+ * @brief run the task with the highest priority which is ready
+ * 
+ * @return false if there was nothing to do
+ */
+bool scheduler_dispatch(void);
+
+/**
+ * @brief the endless dispatch loop, sleeps while there is nothing to do
+ */
+void scheduler_run(void);
+
+/**
+ * @brief how often a task was still ready when its next period started
+ * 
+ * @param taskIndex index into the task table
+ */
+uint16_t scheduler_getOverruns(uint8_t taskIndex);
+
+/**
+ * @brief reset all overrun counters
+ */
+void scheduler_resetOverruns(void);
+
+/**
+ * @brief the max time from a tick which woke the CPU until its task got called
+ * 
+ * @return TASK_TIMER counts, i.e. F_CPU cycles
+ */
+uint16_t scheduler_getMaxWakeLatency(void);
+
+/**
+ * @brief reset the max wake latency
+ */
+void scheduler_resetMaxWakeLatency(void);
+
+#endif
@@ -15,6 +15,8 @@
  */
 #include "ssd1306.h"
 #include "i2c.h"
+#include "strub_common.h"
+#include "systick.h"
 #include "gfx/font_fixed_5x8.h"
 
 #include <stdbool.h>
@@ -66,7 +68,7 @@ PROGMEM const static char init_options[] = {
     0x12,
 
     SSD1306_SETCONTRAST, // default contrast
-    0x3F,
+    SSD1306_DEFAULT_CONTRAST,
 
     SSD1306_SETPRECHARGE, // default pre-charge period
     0xF1,
@@ -80,6 +82,72 @@ PROGMEM const static char init_options[] = {
     SSD1306_DISPLAYON
 };
 
+// up to that many unchanged cells get re-sent to merge two runs.
+// A new window costs about as much as 2 cells.
+#define SSD1306_CACHE_MAX_GAP      2
+
+#ifdef SSD1306_TEXT_CACHE
+
+// values in the text cache besides the plain characters
+#define SSD1306_CACHE_UNKNOWN      0x00
+#define SSD1306_CACHE_LARGE_PART   0x01 // covered by a large glyph
+#define SSD1306_CACHE_LARGE        0x80 // OR'ed to the char of a large glyph, stored in its lower left cell
+
+/**
+ * @brief what the display currently shows in each 6x8 cell
+ */
+static uint8_t textCache[SSD1306_TEXT_ROWS][SSD1306_TEXT_COLUMNS];
+
+static void ssd1306_cache_fill(uint8_t value) {
+    for (uint8_t row = 0; row < SSD1306_TEXT_ROWS; row++) {
+        for (uint8_t column = 0; column < SSD1306_TEXT_COLUMNS; column++) {
+            textCache[row][column] = value;
+        }
+    }
+}
+
+/**
+ * @brief store the new content of a cell
+ * 
+ * A large glyph only gets tracked in its lower left cell.
+ * If any of its other 3 cells gets overwritten, the large glyph isn't intact anymore.
+ * We do not know which large glyph covered the cell, so we forget all candidates.
+ */
+static void ssd1306_cache_store(uint8_t row, uint8_t column, uint8_t value) {
+    if (column > 0 && (textCache[row][column-1] & SSD1306_CACHE_LARGE)) {
+        textCache[row][column-1] = SSD1306_CACHE_UNKNOWN;
+    }
+    if (row < SSD1306_TEXT_ROWS-1) {
+        if (textCache[row+1][column] & SSD1306_CACHE_LARGE) {
+            textCache[row+1][column] = SSD1306_CACHE_UNKNOWN;
+        }
+        if (column > 0 && (textCache[row+1][column-1] & SSD1306_CACHE_LARGE)) {
+            textCache[row+1][column-1] = SSD1306_CACHE_UNKNOWN;
+        }
+    }
+    textCache[row][column] = value;
+}
+
+/**
+ * @brief forget the cells touched by painting into the given pixel window
+ */
+static void ssd1306_cache_forget(uint8_t x, uint8_t xEnd, uint8_t page, uint8_t pageEnd) {
+    uint8_t columnEnd = xEnd / 6;
+    if (columnEnd >= SSD1306_TEXT_COLUMNS) {
+        columnEnd = SSD1306_TEXT_COLUMNS - 1;
+    }
+    for (uint8_t row = page; row <= pageEnd; row++) {
+        for (uint8_t column = x / 6; column <= columnEnd; column++) {
+            ssd1306_cache_store(row, column, SSD1306_CACHE_UNKNOWN);
+        }
+    }
+}
+
+void ssd1306_invalidateTextCache(void) {
+    ssd1306_cache_fill(SSD1306_CACHE_UNKNOWN);
+}
+
+#endif
 
 uint8_t ssd1306_send_single_command(char command) {
 	i2c_start_write(SSD1306_I2C_ADDRESS);
@@ -130,6 +198,10 @@ uint8_t ssd1306_init(void) {
 	}
 	i2c_stop();
 
+#ifdef SSD1306_TEXT_CACHE
+    ssd1306_invalidateTextCache();
+#endif
+
     return nack;
 }
 
@@ -146,9 +218,9 @@ uint8_t ssd1306_send_multiple_data(int length, char data[]) {
     }
 
 	i2c_start_write(SSD1306_I2C_ADDRESS);
-	uint8_t nack = 0;
+	// a single control byte without continuation turns all following bytes into data
+	uint8_t nack = i2c_write_byte(SSD1306_CONTROL_BYTE_ONE_DATA);
 	for (int i = 0; i < length; i++) {
-        nack |= i2c_write_byte(i == length-1 ? SSD1306_CONTROL_BYTE_ONE_DATA : SSD1306_CONTROL_BYTE_MULTIPLE_DATA);
 		nack |= i2c_write_byte(data[i]);
 	}
 	i2c_stop();
@@ -162,49 +234,181 @@ uint8_t ssd1306_send_progmem_multiple_data(const int length, const char *data) {
     }
 
 	i2c_start_write(SSD1306_I2C_ADDRESS);
-	uint8_t nack = 0;
+	uint8_t nack = i2c_write_byte(SSD1306_CONTROL_BYTE_ONE_DATA);
 	for (int i = 0; i < length; i++) {
-        nack |= i2c_write_byte(i == length-1 ? SSD1306_CONTROL_BYTE_ONE_DATA : SSD1306_CONTROL_BYTE_MULTIPLE_DATA);
 		nack |= i2c_write_byte(pgm_read_byte(data + i));
 	}
 	i2c_stop();
     return nack;
 }
 
+/**
+ * @brief open a transaction which sets the GDRAM window and then switches to data
+ * 
+ * Each window command goes with a continuation control byte,
+ * the last control byte turns the rest of the transaction into a GDRAM data stream.
+ * Send the data via i2c_write_byte() and finish the transaction with i2c_stop().
+ * 
+ * @return uint8_t 0 if ok
+ */
+static uint8_t ssd1306_start_window(uint8_t column, uint8_t columnEnd, uint8_t page, uint8_t pageEnd) {
+    char commands[] = {SSD1306_COLUMNADDR, column, columnEnd, SSD1306_PAGEADDR, page, pageEnd};
+    uint8_t nack = 0;
+
+    i2c_start_write(SSD1306_I2C_ADDRESS);
+    for (uint8_t i = 0; i < sizeof(commands); i++) {
+        nack |= i2c_write_byte(SSD1306_CONTROL_BYTE_MULTIPLE_COMMANDS);
+        nack |= i2c_write_byte(commands[i]);
+    }
+    nack |= i2c_write_byte(SSD1306_CONTROL_BYTE_ONE_DATA);
+    return nack;
+}
+
+// text cursor for ssd1306_print
+static uint8_t cursorRow = 0;
+static uint8_t cursorColumn = 0;
+
+// pixel column if the cursor got set to a position which is not in the 6x8 grid
+#define SSD1306_CURSOR_IN_GRID 0xFF
+static uint8_t cursorPixel = SSD1306_CURSOR_IN_GRID;
+
 uint8_t ssd1306_setBankColPos(char bank, char column) {
     char commands[] = {SSD1306_PAGEADDR, bank, 7,
                        SSD1306_COLUMNADDR, column, 127 
     };
 
+    // ssd1306_print continues at this position
+    uint8_t x = (uint8_t) column - SSD1306_COLUMNSTART;
+    cursorRow = bank;
+    if (x % 6 == 0 && x / 6 < SSD1306_TEXT_COLUMNS) {
+        cursorColumn = x / 6;
+        cursorPixel = SSD1306_CURSOR_IN_GRID;
+    }
+    else {
+        cursorPixel = x;
+    }
+
     return ssd1306_send_multiple_commands(sizeof(commands), commands);
 }
 
 uint8_t ssd1306_clear_display(void) {
-    uint8_t nack = 0;
-    char command[] = {SSD1306_PAGEADDR, 0, SSD1306_PAGESIZE-1, SSD1306_COLUMNADDR, SSD1306_COLUMNSTART, SSD1306_COLUMNEND};
-    ssd1306_send_multiple_commands(sizeof(command), command);
-
-	i2c_start_write(SSD1306_I2C_ADDRESS);
+    uint8_t nack = ssd1306_start_window(SSD1306_COLUMNSTART, SSD1306_COLUMNEND, 0, SSD1306_PAGESIZE-1);
     uint16_t len = SSD1306_WIDTH * SSD1306_PAGESIZE;
     for (uint16_t i=0; i < len; i++) {
-        nack |= i2c_write_byte(i == len-1 ? SSD1306_CONTROL_BYTE_ONE_DATA : SSD1306_CONTROL_BYTE_MULTIPLE_DATA);
 		nack |= i2c_write_byte(0x00);
     }
     i2c_stop();
+
+#ifdef SSD1306_TEXT_CACHE
+    // a cleared cell looks exactly like a blank
+    ssd1306_cache_fill(' ');
+#endif
     return nack;
 }
 
-void ssd1306_printChar(unsigned char c) {
+uint8_t ssd1306_drawBitmap_P(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, const uint8_t* data) {
+    if (w == 0 || pages == 0 || x + w > SSD1306_WIDTH || page + pages > SSD1306_PAGESIZE) {
+        return 1;
+    }
+
+    uint8_t nack = ssd1306_start_window(SSD1306_COLUMNSTART + x, SSD1306_COLUMNSTART + x + w - 1, page, page + pages - 1);
+    uint16_t len = (uint16_t) w * pages;
+    for (uint16_t i=0; i < len; i++) {
+		nack |= i2c_write_byte(pgm_read_byte(data + i));
+    }
+    i2c_stop();
+
+#ifdef SSD1306_TEXT_CACHE
+    ssd1306_cache_forget(x, x + w - 1, page, page + pages - 1);
+#endif
+    return nack;
+}
+
+uint8_t ssd1306_drawFullscreen_P(const uint8_t* data) {
+    return ssd1306_drawBitmap_P(0, 0, SSD1306_WIDTH, SSD1306_PAGESIZE, data);
+}
+
+/**
+ * @brief map the character to the glyph we actually paint
+ */
+static inline unsigned char ssd1306_glyph(unsigned char c) {
     if (c < 32 || c > 127) {
         c = 127; // the block carret
     }
-    char data[6];
-    data[0] = 0x00; // blank row between characters
-    const uint8_t* font = ssd1306_font5x8 + (c-32)*5;
-    for (int i=0; i<5; i++) {
-        data[i+1] = pgm_read_byte(font + i);
+    return c;
+}
+
+/**
+ * @brief stream the 6 columns of a 5x8 glyph into an open data transaction
+ */
+static uint8_t ssd1306_write_glyph(unsigned char c) {
+    const uint8_t* font = ssd1306_font5x8 + (ssd1306_glyph(c)-32)*5;
+    uint8_t nack = i2c_write_byte(0x00); // blank row between characters
+    for (uint8_t i=0; i<5; i++) {
+        nack |= i2c_write_byte(pgm_read_byte(font + i));
     }
-    ssd1306_send_multiple_data(6, data);
+    return nack;
+}
+
+/**
+ * @brief stream one half of a double size glyph into an open data transaction
+ * 
+ * @param upper true for the upper page, false for the lower page
+ */
+static uint8_t ssd1306_write_glyph_large(unsigned char c, bool upper) {
+    const uint8_t* font = ssd1306_font5x8 + (ssd1306_glyph(c)-32)*5;
+    uint8_t nack = i2c_write_byte(0x00); // blank row between characters
+    for (uint8_t i=0; i < 5; i++) {
+        uint8_t fontCol = pgm_read_byte(font + i);
+        uint8_t px;
+
+        if (upper) {
+            px  = (fontCol & 0x08) << 4;
+            px |= (fontCol & 0x08) << 3;
+            px |= (fontCol & 0x04) << 3;
+            px |= (fontCol & 0x04) << 2;
+            px |= (fontCol & 0x02) << 2;
+            px |= (fontCol & 0x02) << 1;
+            px |= (fontCol & 0x01) << 1;
+        }
+        else {
+            px  = (fontCol & 0x80) >> 1;
+            px |= (fontCol & 0x40) >> 1;
+            px |= (fontCol & 0x40) >> 2;
+            px |= (fontCol & 0x20) >> 2;
+            px |= (fontCol & 0x20) >> 3;
+            px |= (fontCol & 0x10) >> 3;
+            px |= (fontCol & 0x10) >> 4;
+        }
+
+        nack |= i2c_write_byte(px);
+        nack |= i2c_write_byte(px);
+    }
+    nack |= i2c_write_byte(0x00); // blank row between characters
+    return nack;
+}
+
+
+/**
+ * @return true if the cell at the given position needs to get transmitted
+ */
+static inline bool ssd1306_cell_changed(uint8_t row, uint8_t column, unsigned char c) {
+#ifdef SSD1306_TEXT_CACHE
+    return textCache[row][column] != ssd1306_glyph(c);
+#else
+    return true;
+#endif
+}
+
+/**
+ * @return true if the large glyph at the given position needs to get transmitted
+ */
+static inline bool ssd1306_cell_changed_large(uint8_t row, uint8_t column, unsigned char c) {
+#ifdef SSD1306_TEXT_CACHE
+    return textCache[row][column] != (ssd1306_glyph(c) | SSD1306_CACHE_LARGE);
+#else
+    return true;
+#endif
 }
 
 
@@ -215,84 +419,256 @@ void ssd1306_printChar(unsigned char c) {
  * @param colunn 0-based column from 0..21
  */
 void ssd1306_setCursorPos(uint8_t row, uint8_t column) {
+    cursorRow = row;
+    cursorColumn = column;
     ssd1306_setBankColPos(row, SSD1306_COLUMNSTART + column*6);
 }
 
+void ssd1306_printChar(unsigned char c) {
+    ssd1306_print((char*) &c, 1);
+}
+
 void ssd1306_printP(uint8_t row, uint8_t column, char* txt, uint8_t maxLen) {
-    ssd1306_setCursorPos(row, column);
-    ssd1306_print(txt, maxLen);
+    if (row >= SSD1306_TEXT_ROWS) {
+        return;
+    }
+
+    uint8_t len = 0;
+    while (len < maxLen && txt[len] != 0 && column + len < SSD1306_TEXT_COLUMNS) {
+        len++;
+    }
+
+    uint8_t i = 0;
+    while (i < len) {
+        if (!ssd1306_cell_changed(row, column + i, txt[i])) {
+            i++;
+            continue;
+        }
+
+        // find the end of this run of changed cells
+        uint8_t runEnd = i + 1;
+        uint8_t gap = 0;
+        for (uint8_t j = i + 1; j < len && gap <= SSD1306_CACHE_MAX_GAP; j++) {
+            if (ssd1306_cell_changed(row, column + j, txt[j])) {
+                runEnd = j + 1;
+                gap = 0;
+            }
+            else {
+                gap++;
+            }
+        }
+
+        // and send the whole run in one go
+        ssd1306_start_window(SSD1306_COLUMNSTART + (column + i)*6, SSD1306_COLUMNSTART + (column + runEnd)*6 - 1, row, row);
+        for (; i < runEnd; i++) {
+            ssd1306_write_glyph(txt[i]);
+#ifdef SSD1306_TEXT_CACHE
+            ssd1306_cache_store(row, column + i, ssd1306_glyph(txt[i]));
+#endif
+        }
+        i2c_stop();
+    }
+
+    cursorRow = row;
+    cursorColumn = column + len;
+    cursorPixel = SSD1306_CURSOR_IN_GRID;
+}
+
+/**
+ * @brief print at a pixel column which is not in the 6x8 grid, bypassing the text cache
+ */
+static void ssd1306_printPixelPos(char* txt, uint8_t maxLen) {
+    if (cursorRow >= SSD1306_TEXT_ROWS) {
+        return;
+    }
+
+    uint8_t len = 0;
+    while (len < maxLen && txt[len] != 0 && cursorPixel + (len + 1)*6 <= SSD1306_WIDTH) {
+        len++;
+    }
+    if (len == 0) {
+        return;
+    }
+
+    uint8_t xEnd = cursorPixel + len*6 - 1;
+    ssd1306_start_window(SSD1306_COLUMNSTART + cursorPixel, SSD1306_COLUMNSTART + xEnd, cursorRow, cursorRow);
+    for (uint8_t i = 0; i < len; i++) {
+        ssd1306_write_glyph(txt[i]);
+    }
+    i2c_stop();
+
+#ifdef SSD1306_TEXT_CACHE
+    ssd1306_cache_forget(cursorPixel, xEnd, cursorRow, cursorRow);
+#endif
+    cursorPixel = xEnd + 1;
 }
 
 void ssd1306_print(char* txt, uint8_t maxLen) {
-    for (int i=0; i<maxLen; i++) {
-        if (txt[i] == 0) {
-            return;
-        }
-        ssd1306_printChar(txt[i]);
+    if (cursorPixel != SSD1306_CURSOR_IN_GRID) {
+        ssd1306_printPixelPos(txt, maxLen);
+        return;
     }
+    ssd1306_printP(cursorRow, cursorColumn, txt, maxLen);
 }
 
 void ssd1306_printChar_largeP(uint8_t row, uint8_t column, unsigned char c) {
-    if (c < 32 || c > 127) {
-        c = 127; // the block carret
+    ssd1306_print_largeP(row, column, (char*) &c, 1);
+}
+
+void ssd1306_print_largeP(uint8_t row, uint8_t column, char* txt, uint8_t maxLen) {
+    if (row <1 || row > 7) {
+        ssd1306_printP(0, 0, "Illegal row", 10);
+        return;
     }
 
-    // paint upper half bytes
-    const uint8_t* font = ssd1306_font5x8 + (c-32)*5;
-    char data[12];
-    data[0] = 0x00; // blank row between characters
-    data[11] = 0x00; // blank row between characters
-    
-    // paint upper half bytes
-    ssd1306_setCursorPos(row-1, column);
-    for (int i=0; i < 5; i++) {
-        uint8_t fontCol = pgm_read_byte(font + i);
+    uint8_t len = 0;
+    while (len < maxLen && txt[len] != 0 && column + 2*len + 1 < SSD1306_TEXT_COLUMNS) {
+        len++;
+    }
 
-        uint8_t px = (fontCol & 0x08) << 4;
-        px |= (fontCol & 0x08) << 3;
-        px |= (fontCol & 0x04) << 3;
-        px |= (fontCol & 0x04) << 2;
-        px |= (fontCol & 0x02) << 2;
-        px |= (fontCol & 0x02) << 1;
-        px |= (fontCol & 0x01) << 1;
+    uint8_t i = 0;
+    while (i < len) {
+        if (!ssd1306_cell_changed_large(row, column + 2*i, txt[i])) {
+            i++;
+            continue;
+        }
+
+        uint8_t runEnd = i + 1;
+        while (runEnd < len && ssd1306_cell_changed_large(row, column + 2*runEnd, txt[runEnd])) {
+            runEnd++;
+        }
 
-        data[(i<<1)+1]=px;
-        data[(i<<1)+2]=px;
+        // the window spans both pages, so the upper halves come first, then the lower halves
+        ssd1306_start_window(SSD1306_COLUMNSTART + (column + 2*i)*6, SSD1306_COLUMNSTART + (column + 2*runEnd)*6 - 1, row-1, row);
+        for (uint8_t j = i; j < runEnd; j++) {
+            ssd1306_write_glyph_large(txt[j], true);
+        }
+        for (uint8_t j = i; j < runEnd; j++) {
+            ssd1306_write_glyph_large(txt[j], false);
+#ifdef SSD1306_TEXT_CACHE
+            uint8_t cellColumn = column + 2*j;
+            ssd1306_cache_store(row-1, cellColumn,   SSD1306_CACHE_LARGE_PART);
+            ssd1306_cache_store(row-1, cellColumn+1, SSD1306_CACHE_LARGE_PART);
+            ssd1306_cache_store(row,   cellColumn+1, SSD1306_CACHE_LARGE_PART);
+            ssd1306_cache_store(row,   cellColumn,   ssd1306_glyph(txt[j]) | SSD1306_CACHE_LARGE);
+#endif
+        }
+        i2c_stop();
+        i = runEnd;
     }
-    ssd1306_send_multiple_data(12, data);
+}
 
-    // paint lower half bytes
-    ssd1306_setCursorPos(row, column);
-    for (int i=0; i < 5; i++) {
-        uint8_t fontCol = pgm_read_byte(font + i);
+/************ SSD1306 POWER *************/
+
+struct ssd1306_power_state {
+    struct pt pt;
+
+    uint8_t contrast;     // what the panel currently uses
+    uint8_t fullContrast; // brightness while in use
+    uint8_t dimContrast;  // brightness after dimAfter seconds of inactivity
+    bool displayOn;
+
+    uint16_t dimAfter;    // seconds, 0 to never dim
+    uint16_t offAfter;    // seconds, 0 to never switch off
+
+    uint16_t idleSeconds;
+    uint32_t secondStart; // tick at which the current idle second started
+    uint32_t lastStep;    // tick of the last fade step
+};
+
+static struct ssd1306_power_state tsPower = {
+    .contrast = SSD1306_DEFAULT_CONTRAST,
+    .fullContrast = SSD1306_DEFAULT_CONTRAST,
+    .displayOn = true,
+};
 
-        uint8_t px = (fontCol & 0x80) >> 1;
-        px |= (fontCol & 0x40) >> 1;
-        px |= (fontCol & 0x40) >> 2;
-        px |= (fontCol & 0x20) >> 2;
-        px |= (fontCol & 0x20) >> 3;
-        px |= (fontCol & 0x10) >> 3;
-        px |= (fontCol & 0x10) >> 4;
+/**
+ * @brief send the contrast without touching the brightness the power task fades to
+ */
+static uint8_t ssd1306_sendContrast(uint8_t contrast) {
+    char commands[] = {SSD1306_SETCONTRAST, contrast};
+    tsPower.contrast = contrast;
+    return ssd1306_send_multiple_commands(sizeof(commands), commands);
+}
+
+uint8_t ssd1306_setContrast(uint8_t contrast) {
+    // otherwise the power task would fade right back
+    tsPower.fullContrast = contrast;
+    return ssd1306_sendContrast(contrast);
+}
 
-        data[(i<<1)+1]=px;
-        data[(i<<1)+2]=px;
+void ssd1306_fadeTo(uint8_t contrast) {
+    tsPower.fullContrast = contrast;
+}
+
+void ssd1306_setPowerSave(uint8_t dimContrast, uint16_t dimAfter, uint16_t offAfter) {
+    tsPower.dimContrast = dimContrast;
+    tsPower.dimAfter = dimAfter;
+    tsPower.offAfter = offAfter;
+}
+
+void ssd1306_wake(void) {
+    tsPower.idleSeconds = 0;
+    tsPower.secondStart = systick_ticks();
+}
+
+/**
+ * @return true if the display should be switched off completely
+ */
+static inline bool ssd1306_power_off(void) {
+    return tsPower.offAfter != 0 && tsPower.idleSeconds >= tsPower.offAfter;
+}
+
+/**
+ * @return uint8_t the contrast the panel should fade to
+ */
+static uint8_t ssd1306_power_target(void) {
+    if (ssd1306_power_off()) {
+        return 0;
+    }
+    if (tsPower.dimAfter != 0 && tsPower.idleSeconds >= tsPower.dimAfter) {
+        return tsPower.dimContrast;
     }
-    ssd1306_send_multiple_data(12, data);
+    return tsPower.fullContrast;
 }
 
-void ssd1306_print_largeP(uint8_t row, uint8_t column, char* txt, uint8_t maxLen) {
-    if (row <1 || row > 7) {
-        ssd1306_setCursorPos(0,0);
-        ssd1306_print("Illegal row", 10);
-        return;
+PT_THREAD(task_ssd1306_power(void))
+{
+    while (systick_ticks() - tsPower.secondStart >= TASK_TICKS_PER_SECOND) {
+        tsPower.secondStart += TASK_TICKS_PER_SECOND;
+        if (tsPower.idleSeconds < 0xFFFF) {
+            tsPower.idleSeconds++;
+        }
     }
 
-     for (int i=0; i<maxLen; i++) {
-        if (txt[i] == 0) {
-            return;
+    PT_BEGIN(&tsPower.pt);
+
+    uint8_t target = ssd1306_power_target();
+
+    if (target != tsPower.contrast) {
+        if (!tsPower.displayOn) {
+            // waking up, the contrast is still at 0 from fading out
+            ssd1306_send_single_command(SSD1306_DISPLAYON);
+            tsPower.displayOn = true;
+        }
+
+        if (target > tsPower.contrast) {
+            ssd1306_sendContrast(target - tsPower.contrast > SSD1306_FADE_STEP ? tsPower.contrast + SSD1306_FADE_STEP : target);
+        }
+        else {
+            ssd1306_sendContrast(tsPower.contrast - target > SSD1306_FADE_STEP ? tsPower.contrast - SSD1306_FADE_STEP : target);
         }
-        ssd1306_printChar_largeP(row, column + 2*i, txt[i]);
+
+        tsPower.lastStep = systick_ticks();
+        PT_WAIT_UNTIL(&tsPower.pt, systick_ticks() - tsPower.lastStep >= SSD1306_FADE_TICKS);
     }
+    else if (tsPower.displayOn && ssd1306_power_off()) {
+        // faded out completely, the GDRAM content stays
+        ssd1306_send_single_command(SSD1306_DISPLAYOFF);
+        tsPower.displayOn = false;
+    }
+
+    PT_END(&tsPower.pt);
 }
 
 /************ SSD1306 END *************/
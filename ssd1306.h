@@ -17,6 +17,9 @@
     #define __DISPLAY_SSD1306_H__
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "pt.h"
 
 #define SSD1306_CONTROL_BYTE_ONE_COMMAND               0x00
 #define SSD1306_CONTROL_BYTE_MULTIPLE_COMMANDS         0x80
@@ -50,6 +53,27 @@
 #define SSD1306_SWITCHCAPVCC                           0x02
 #define SSD1306_NOP                                    0xE3
 
+#define SSD1306_DEFAULT_CONTRAST                       0x3F
+
+// contrast change per fade step
+#ifndef SSD1306_FADE_STEP
+    #define SSD1306_FADE_STEP                          4
+#endif
+// task ticks between two fade steps
+#ifndef SSD1306_FADE_TICKS
+    #define SSD1306_FADE_TICKS                         20
+#endif
+
+// the 6x8 text grid
+#define SSD1306_TEXT_COLUMNS                           21
+#define SSD1306_TEXT_ROWS                              8
+
+/*
+ * Define SSD1306_TEXT_CACHE to keep a shadow of the characters on the screen.
+ * The print functions then only transmit the cells which actually changed.
+ * This costs SSD1306_TEXT_ROWS * SSD1306_TEXT_COLUMNS bytes of RAM.
+ */
+
 
 /**
  * @brief initialize the I2C and the SSD1306 controller
@@ -74,6 +98,15 @@ void ssd1306_send_single_data(char data);
  */
 uint8_t ssd1306_send_multiple_data(int length, char data[]);
 
+/**
+ * @brief send multiple data bytes from the program memory to the SSD1306 controller
+ * 
+ * @param length 
+ * @param data in PROGMEM
+ * @return uint8_t 0 if ok
+ */
+uint8_t ssd1306_send_progmem_multiple_data(const int length, const char *data);
+
 uint8_t ssd1306_send_single_command(char command);
 uint8_t ssd1306_send_multiple_commands(int length, char commands[]);
 
@@ -83,6 +116,8 @@ uint8_t ssd1306_send_multiple_commands(int length, char commands[]);
  * 
  * @param bank 0-based bank 0-7, starting from top to bottom. A bank is a 8-bit high row. 
  *              LSB is the uppermost pixel.
+ * Also moves the text cursor of #ssd1306_print to this position.
+ * 
  * @param column 0-based column from 0 to 128 from left to right. 
  * @return uint8_t 0 if ok
  */
@@ -95,6 +130,33 @@ uint8_t ssd1306_setBankColPos(char bank, char column);
  */
 uint8_t ssd1306_clear_display(void);
 
+/**
+ * @brief paint a bitmap from the program memory
+ * 
+ * The window gets set up and the whole image streamed in a single I2C transaction.
+ * The bitmap is organised in pages: the first w bytes are the topmost page,
+ * each byte is a column of 8 pixels with the LSB being the uppermost pixel.
+ * 
+ * @param x 0-based pixel column from 0..127
+ * @param page 0-based page (8 pixel high row) from 0..7
+ * @param w width in pixels
+ * @param pages height in pages
+ * @param data w*pages bytes in PROGMEM
+ * @return uint8_t 0 if ok
+ */
+uint8_t ssd1306_drawBitmap_P(uint8_t x, uint8_t page, uint8_t w, uint8_t pages, const uint8_t* data);
+
+/**
+ * @brief paint a full screen image from the program memory
+ * 
+ * This sends just the 1024 data bytes and a single window setup.
+ * Run the I2C bus as fast as the panel allows, see #i2c_setup.
+ * 
+ * @param data 1024 bytes in PROGMEM, organised like in #ssd1306_drawBitmap_P
+ * @return uint8_t 0 if ok
+ */
+uint8_t ssd1306_drawFullscreen_P(const uint8_t* data);
+
 /**
  * @brief set cursor position for text 8x5 pixel based output
  * 
@@ -104,13 +166,29 @@ uint8_t ssd1306_clear_display(void);
 void ssd1306_setCursorPos(uint8_t row, uint8_t column);
 
 /**
- * @brief print text in a 8x5 pixel font
+ * @brief print text in a 8x5 pixel font at the cursor position
+ * 
+ * The cursor is the position set via #ssd1306_setCursorPos or #ssd1306_setBankColPos
+ * or the end of the previously printed text.
+ * A pixel column which is not a multiple of 6 bypasses the text cache.
+ * Such text just gets sent and invalidates the cells it touches.
  * 
  * @param txt to print, zero terminated
  * @param maxLen maximum length if zero termination is missing or broken.
  */
 void ssd1306_print(char* txt, uint8_t maxLen);
 
+/**
+ * @brief print text in a 8x5 pixel font at the given position
+ * 
+ * Each run of changed characters gets sent in a single I2C transaction.
+ * Text beyond the right edge gets cut off.
+ * 
+ * @param row 0-based row from 0..7
+ * @param column 0-based 6-bit wide column from 0..20
+ * @param txt to print, zero terminated
+ * @param maxLen maximum length if zero termination is missing or broken.
+ */
 void ssd1306_printP(uint8_t row, uint8_t column, char* txt, uint8_t maxLen);
 
 void ssd1306_printChar_largeP(uint8_t row, uint8_t column, unsigned char c);
@@ -129,4 +207,64 @@ void ssd1306_printChar_largeP(uint8_t row, uint8_t column, unsigned char c);
  */
 void ssd1306_print_largeP(uint8_t row, uint8_t column, char* txt, uint8_t maxLen);
 
+/**
+ * @brief set the contrast right away
+ * 
+ * Also becomes the brightness #task_ssd1306_power uses while the display is in use.
+ * 
+ * @param contrast 0..255
+ * @return uint8_t 0 if ok
+ */
+uint8_t ssd1306_setContrast(uint8_t contrast);
+
+/**
+ * @brief smoothly fade to the given contrast
+ * 
+ * This is the brightness used while the display is in use.
+ * The fading is done by #task_ssd1306_power.
+ * 
+ * @param contrast 0..255
+ */
+void ssd1306_fadeTo(uint8_t contrast);
+
+/**
+ * @brief configure dimming and switching the display off after inactivity
+ * 
+ * The inactivity time gets reset by #ssd1306_wake.
+ * Switching off fades out first and then only disables the panel,
+ * the content stays in the GDRAM and shows up again on wake.
+ * 
+ * @param dimContrast contrast while dimmed
+ * @param dimAfter seconds of inactivity until dimming, 0 to never dim
+ * @param offAfter seconds of inactivity until switching off, 0 to never switch off
+ */
+void ssd1306_setPowerSave(uint8_t dimContrast, uint16_t dimAfter, uint16_t offAfter);
+
+/**
+ * @brief signal user activity
+ * 
+ * Fades the display back to full brightness.
+ * Can be used directly as button activity callback:
+ * setButtonActivityCallback(ssd1306_wake);
+ */
+void ssd1306_wake(void);
+
+/**
+ * @brief fades the contrast and handles the inactivity timeouts
+ * 
+ * Each fade step is a single command transaction.
+ */
+PT_THREAD(task_ssd1306_power(void));
+
+#ifdef SSD1306_TEXT_CACHE
+/**
+ * @brief forget what we know about the screen content
+ * 
+ * Needs to be called after painting to the GDRAM without the print functions,
+ * e.g. via #ssd1306_setBankColPos and #ssd1306_send_multiple_data.
+ * The next print calls will then transmit all their characters.
+ */
+void ssd1306_invalidateTextCache(void);
+#endif
+
 #endif
\ No newline at end of file
@@ -19,6 +19,8 @@
 
 #include <avr/io.h>
 
+#include "fastio.h"
+
 // we run at 10 MHz, so counting to5k gives us 0.5 ms or 2000 task ticks per second.
 #ifndef TASK_TIMER_OVERFLOW
   #define TASK_TIMER_OVERFLOW 5000
@@ -28,12 +30,14 @@
   #define TASK_TIMER TCB0
 #endif
 
+#define TASK_TICKS_PER_SECOND (F_CPU / TASK_TIMER_OVERFLOW)
+
 #define set_bit(register, bit)  register |= (1 << bit)
 #define clear_bit(register, bit)  register &= ~(1 << bit)
 
 
 // bit-leiste um zu merken ob der task in dem zyklus schon abgearbeitet wurde
-// wird vom timer overflow auf FF gesetzt
+// wird vom timer overflow auf FF gesetzt, siehe systick.h
 extern volatile uint8_t taskTriggered; 
 
 
@@ -107,7 +111,11 @@ uint16_t nextRandom(void);
   #endif
 
   //X #define DEBUGLN ser_out((uint8_t) __LINE__ & 0x00ff);
-  #define SER_OUT(val) ser_out(&SER_PORT, SER_CLK, SER_DATA, val);
+  #define SER_OUT(val) \
+    do { \
+      FIO_DIR_OUT(SER_PORT, SER_CLK | SER_DATA); \
+      FIO_SHIFT_OUT_LSB_FIRST(SER_PORT, SER_CLK, SER_PORT, SER_DATA, val); \
+    } while (0);
 
 #else
   //X #define DEBUGLN
@@ -118,6 +126,8 @@ uint16_t nextRandom(void);
 /**
  * @brief Output something to a 74HC164 shift register with 8 LEDs
  * 
+ * Prefer SER_OUT which uses the fixed SER_PORT pins and is a lot faster.
+ * 
  * @param val 
  */
 void ser_out(volatile PORT_t* port, uint8_t clkPin, uint8_t dataPin, uint8_t val);
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "systick.h"
+
+#include <avr/interrupt.h>
+
+// set to 0xFF on every tick, each task can clear its own bit
+volatile uint8_t taskTriggered = 0;
+
+static volatile uint32_t systickTicks = 0;
+
+// the counts at the start of the current tick
+static volatile uint32_t systickCounts = 0;
+
+static void (*_cbTick)(void) = 0;
+
+
+void systick_init(void) {
+    TASK_TIMER.CTRLA = 0;
+    TASK_TIMER.CTRLB = TCB_CNTMODE_INT_gc; // periodic interrupt
+    TASK_TIMER.CCMP = TASK_TIMER_OVERFLOW - 1;
+    TASK_TIMER.CNT = 0;
+    TASK_TIMER.INTFLAGS = TCB_CAPT_bm;
+    TASK_TIMER.INTCTRL = TCB_CAPT_bm;
+    TASK_TIMER.CTRLA = TCB_CLKSEL_CLKDIV1_gc | TCB_ENABLE_bm;
+}
+
+void systick_setTickCallback(void (*callback)(void)) {
+    _cbTick = callback;
+}
+
+void (*systick_getTickCallback(void))(void) {
+    return _cbTick;
+}
+
+void systick_tick(void) {
+    TASK_TIMER.INTFLAGS = TCB_CAPT_bm;
+
+    systickTicks++;
+    systickCounts += TASK_TIMER_OVERFLOW;
+    taskTriggered = 0xFF;
+
+    if (_cbTick != 0) {
+        (*_cbTick)();
+    }
+}
+
+#ifndef SYSTICK_EXTERNAL_ISR
+ISR(TASK_TIMER_vect) {
+    systick_tick();
+}
+#endif
+
+uint32_t systick_ticks(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t ticks = systickTicks;
+    SREG = sreg;
+    return ticks;
+}
+
+uint32_t systick_counts(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint32_t counts = systickCounts;
+    uint16_t cnt = TASK_TIMER.CNT;
+    if ((TASK_TIMER.INTFLAGS & TCB_CAPT_bm) && cnt < TASK_TIMER_OVERFLOW / 2) {
+        // the counter already wrapped but the ISR did not run yet
+        counts += TASK_TIMER_OVERFLOW;
+    }
+    SREG = sreg;
+    return counts + cnt;
+}
+
+void timeout_start(Timeout* pTimeout, uint32_t counts) {
+    pTimeout->start = systick_counts();
+    pTimeout->duration = counts;
+}
+
+bool timeout_expired(Timeout* pTimeout) {
+    return systick_counts() - pTimeout->start >= pTimeout->duration;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2018-2024 Mark Struberg
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __SYSTICK_H__
+    #define __SYSTICK_H__
+
+/**
+ * @file systick.h
+ * @author Mark Struberg (struberg@apache.org)
+ * @brief time base on top of the TASK_TIMER
+ * 
+ * The TASK_TIMER runs with F_CPU and fires every TASK_TIMER_OVERFLOW counts,
+ * which is a TASK tick. The ISR counts the ticks in 32 bit.
+ * For shorter durations the counts of the current tick get added,
+ * so timeouts are accurate to a single CPU cycle.
+ * 
+ * Timeouts are wrap around safe as long as they are shorter than 2^31 counts,
+ * that is 214 seconds at 10MHz. Use the ticks for anything longer.
+ * 
+ * If the application needs its own TASK_TIMER ISR, define SYSTICK_EXTERNAL_ISR
+ * and call #systick_tick from it.
+ */
+
+#include <stdbool.h>
+#include <avr/io.h>
+
+#include "strub_common.h"
+
+#ifndef TASK_TIMER_vect
+    #define TASK_TIMER_vect TCB0_INT_vect
+#endif
+
+// compile time conversions to timer counts
+#define SYSTICK_US(us) ((uint32_t) ((us) * (F_CPU / 1000UL) / 1000UL))
+#define SYSTICK_MS(ms) ((uint32_t) ((ms) * (F_CPU / 1000UL)))
+
+// compile time conversions to TASK ticks, rounded up
+#define SYSTICK_MS_TO_TICKS(ms) ((uint32_t) (((ms) * TASK_TICKS_PER_SECOND + 999UL) / 1000UL))
+#define SYSTICK_US_TO_TICKS(us) ((uint32_t) (((us) * TASK_TICKS_PER_SECOND + 999999UL) / 1000000UL))
+
+/**
+ * @brief a timeout in timer counts
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t duration;
+} Timeout;
+
+/**
+ * @brief start the TASK_TIMER with a period of TASK_TIMER_OVERFLOW counts
+ * 
+ * Interrupts must be enabled afterwards.
+ */
+void systick_init(void);
+
+/**
+ * @brief does the work of a single tick
+ * 
+ * Only to be called from the TASK_TIMER ISR if SYSTICK_EXTERNAL_ISR is defined.
+ */
+void systick_tick(void);
+
+/**
+ * @brief register a function which gets called on every tick
+ * 
+ * NOTE that it gets invoked from inside the ISR and must be short.
+ * There is only a single callback. #scheduler_init takes it over and calls
+ * the one registered before, so don't register another one after that.
+ * 
+ * @param callback the function or 0 to remove it
+ */
+void systick_setTickCallback(void (*callback)(void));
+
+/**
+ * @return the currently registered tick callback or 0
+ */
+void (*systick_getTickCallback(void))(void);
+
+/**
+ * @return the TASK ticks since #systick_init
+ */
+uint32_t systick_ticks(void);
+
+/**
+ * @return the timer counts since #systick_init, the current tick included
+ */
+uint32_t systick_counts(void);
+
+/**
+ * @brief start a timeout
+ * 
+ * @param pTimeout the timeout
+ * @param counts the duration, e.g. SYSTICK_US(40)
+ */
+void timeout_start(Timeout* pTimeout, uint32_t counts);
+
+/**
+ * @return true if the duration passed since #timeout_start
+ */
+bool timeout_expired(Timeout* pTimeout);
+
+#endif
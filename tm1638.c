@@ -14,90 +14,312 @@
  * limitations under the License.
  */
 #include "tm1638.h"
+#include "fastio.h"
+#include "gfx/font_7seg.h"
 
+#include <util/delay.h>
 
-static volatile PORT_t* tm1638_port;
-static uint8_t tm1638_stbPin;
-static uint8_t tm1638_clkPin;
-static uint8_t tm1638_dioPin;
+static struct tm1638_state {
+    struct pt pt;
 
-void tm1638_init(volatile PORT_t* port, uint8_t stbPin, uint8_t clkPin, uint8_t dioPin) {
-    tm1638_port = port;
-    tm1638_stbPin = stbPin;
-    tm1638_clkPin = clkPin;
-    tm1638_dioPin = dioPin;
+    // all initialised boards for the batched refresh
+    Tm1638* boards[TM1638_MAX_BOARDS];
+    uint8_t boardCount;
 
-    // switch the pins to output mode
-    tm1638_port->DIRSET = (1<<tm1638_clkPin) | (1<<tm1638_stbPin) | (1<<tm1638_dioPin);
+    // the board task_tm1638 currently works on
+    uint8_t currentBoard;
+} tsTm1638 = {0,};
 
-    tm1638_port->OUTSET = (1<<tm1638_stbPin); //passive mode STB high
-    tm1638_port->OUTCLR = (1<<tm1638_clkPin) | (1<<tm1638_dioPin); // clk starts with low and data 0
+#define TM1638_STB_LOW(pBoard)  ((pBoard)->pStbPort->OUTCLR = (pBoard)->stbMask)
+#define TM1638_STB_HIGH(pBoard) ((pBoard)->pStbPort->OUTSET = (pBoard)->stbMask)
 
-    tm1638_sendCmd(TM1638_CMD_SET_BRIGHTNESS | 0xB);
-    tm1638_sendCmd(TM1638_CMD_AUTO_INCREMENT);
+
+void tm1638_setup(void) {
+    // switch the shared pins to output mode
+    TM1638_PORT.DIRSET = (1<<TM1638_CLK_PIN) | (1<<TM1638_DIO_PIN);
+    TM1638_PORT.OUTCLR = (1<<TM1638_CLK_PIN) | (1<<TM1638_DIO_PIN); // clk starts with low and data 0
+
+    // DIO is open drain while the keys get read
+    (&TM1638_PORT.PIN0CTRL)[TM1638_DIO_PIN] |= PORT_PULLUPEN_bm;
+}
+
+void tm1638_init(Tm1638* pBoard, PORT_t* pStbPort, uint8_t stbPin) {
+    pBoard->pStbPort = pStbPort;
+    pBoard->stbMask = 1<<stbPin;
+
+    pStbPort->DIRSET = pBoard->stbMask;
+    pStbPort->OUTSET = pBoard->stbMask; //passive mode STB high
+
+    tm1638_sendCmd(pBoard, TM1638_CMD_SET_BRIGHTNESS | 0xB);
+    tm1638_sendCmd(pBoard, TM1638_CMD_AUTO_INCREMENT);
 
     // clear all data registers
-    tm1638_port->OUTCLR = (1<<tm1638_stbPin);
-    tm1638_sendDataByte(TM1638_CMD_SET_ADDRESS | 0x0);
-    for (uint8_t i=0; i<16; i++) {
+    tm1638_startDataFrame(pBoard, 0x0);
+    for (uint8_t i=0; i<TM1638_REGISTERS; i++) {
         tm1638_sendDataByte(0x80);
+        pBoard->shadow[i] = 0x80;
+    }
+    tm1638_endDataFrame(pBoard);
+    pBoard->dirty = 0;
+
+    for (uint8_t i=0; i < tsTm1638.boardCount; i++) {
+        if (tsTm1638.boards[i] == pBoard) {
+            return;
+        }
+    }
+    if (tsTm1638.boardCount < TM1638_MAX_BOARDS) {
+        tsTm1638.boards[tsTm1638.boardCount++] = pBoard;
     }
-    tm1638_port->OUTSET = (1<<tm1638_stbPin);
 }
 
 void tm1638_sendDataByte(uint8_t data) {
-    for (uint8_t i = 0; i<8; i++) {
-        tm1638_port->OUTCLR = (1<<tm1638_clkPin);
-        if (data & 0x01) {
-            tm1638_port->OUTSET = (1<<tm1638_dioPin);
+    FIO_SHIFT_OUT_LSB_FIRST_DELAYED(TM1638_PORT, (1<<TM1638_CLK_PIN), TM1638_PORT, (1<<TM1638_DIO_PIN), data,
+                                    FIO_NS_TO_CYCLES(TM1638_CLK_HALF_NS));
+}
+
+void tm1638_sendCmd(Tm1638* pBoard, uint8_t cmd) {
+    TM1638_STB_LOW(pBoard);
+    tm1638_sendDataByte(cmd);
+    TM1638_STB_HIGH(pBoard);
+}
+
+void tm1638_startDataFrame(Tm1638* pBoard, uint8_t address) {
+    TM1638_STB_LOW(pBoard);
+    tm1638_sendDataByte(TM1638_CMD_SET_ADDRESS | (address & 0x0F) );
+}
+
+void tm1638_endDataFrame(Tm1638* pBoard) {
+    TM1638_STB_HIGH(pBoard);
+}
+
+/**
+ * @brief clock in a byte, LSB first
+ * 
+ * The TM1638 shifts out the next bit on the falling clock edge.
+ */
+static uint8_t tm1638_receiveDataByte(void) {
+    uint8_t data = 0;
+    for (uint8_t bit = 0x01; bit != 0; bit <<= 1) {
+        FIO_CLR(TM1638_PORT, (1<<TM1638_CLK_PIN));
+        _delay_us(TM1638_READ_DELAY_US);
+        FIO_SET(TM1638_PORT, (1<<TM1638_CLK_PIN));
+        if (FIO_READ(TM1638_PORT, (1<<TM1638_DIO_PIN))) {
+            data |= bit;
         }
-        else {
-            tm1638_port->OUTCLR = (1<<tm1638_dioPin);
+        __builtin_avr_delay_cycles(FIO_NS_TO_CYCLES(TM1638_CLK_HALF_NS));
+    }
+    return data;
+}
+
+uint8_t tm1638_readKeys(Tm1638* pBoard) {
+    TM1638_STB_LOW(pBoard);
+    tm1638_sendDataByte(TM1638_CMD_READ_KEYS);
+
+    // release DIO, the chip needs a moment before it sends the scan data
+    FIO_DIR_IN(TM1638_PORT, (1<<TM1638_DIO_PIN));
+    _delay_us(TM1638_READ_WAIT_US);
+
+    uint8_t keys = 0;
+    for (uint8_t i = 0; i < 4; i++) {
+        // each byte holds 2 keys in bit 0 and bit 4
+        keys |= (tm1638_receiveDataByte() & 0x11) << i;
+    }
+
+    TM1638_STB_HIGH(pBoard);
+    FIO_CLR(TM1638_PORT, (1<<TM1638_DIO_PIN));
+    FIO_DIR_OUT(TM1638_PORT, (1<<TM1638_DIO_PIN));
+
+    return keys;
+}
+
+void tm1638_setRaw(Tm1638* pBoard, uint8_t address, uint8_t data) {
+    address &= 0x0F;
+    if (pBoard->shadow[address] != data) {
+        pBoard->shadow[address] = data;
+        pBoard->dirty |= 1U<<address;
+    }
+}
+
+void tm1638_setDigit(Tm1638* pBoard, uint8_t digit, uint8_t segments) {
+    tm1638_setRaw(pBoard, digit << 1, segments);
+}
+
+void tm1638_setLed(Tm1638* pBoard, uint8_t led, bool on) {
+    tm1638_setRaw(pBoard, (led << 1) | 0x01, on ? 0x01 : 0x00);
+}
+
+/**
+ * @brief find the dirty registers between first and last
+ * 
+ * @return the number of dirty registers, pLo and pHi are only set if > 0
+ */
+static uint8_t tm1638_dirtyRange(Tm1638* pBoard, uint8_t first, uint8_t last, uint8_t* pLo, uint8_t* pHi) {
+    uint8_t count = 0;
+    for (uint8_t address = first; address <= last; address++) {
+        if (pBoard->dirty & (1U<<address)) {
+            if (count == 0) {
+                *pLo = address;
+            }
+            *pHi = address;
+            count++;
         }
-        tm1638_port->OUTSET = (1<<tm1638_clkPin);
-        data = data >> 1;
     }
+    return count;
 }
 
-void tm1638_sendCmd(uint8_t cmd) {
-    tm1638_port->OUTCLR = (1<<tm1638_stbPin);
-    tm1638_sendDataByte(cmd);
-    tm1638_port->OUTSET = (1<<tm1638_stbPin);
+/**
+ * @brief whether fixed address writes need fewer bytes on the wire than a single
+ *        auto-increment burst over the dirty range, including the mode switches
+ */
+static bool tm1638_useFixedAddress(uint8_t count, uint8_t lo, uint8_t hi) {
+    return 2 + 2 * count < 1 + (hi - lo + 1);
 }
 
-void tm1638_startDataFrame(uint8_t address) {
-    tm1638_port->OUTCLR = (1<<tm1638_stbPin);
-    tm1638_sendDataByte(TM1638_CMD_SET_ADDRESS | (address & 0x0F) );
+/**
+ * @brief write each dirty register between lo and hi, the board must be in fixed address mode
+ */
+static void tm1638_sendFixed(Tm1638* pBoard, uint8_t lo, uint8_t hi) {
+    for (uint8_t address = lo; address <= hi; address++) {
+        if (pBoard->dirty & (1U<<address)) {
+            tm1638_startDataFrame(pBoard, address);
+            tm1638_sendDataByte(pBoard->shadow[address]);
+            tm1638_endDataFrame(pBoard);
+            pBoard->dirty &= ~(1U<<address);
+        }
+    }
 }
 
-void tm1638_endDataFrame(void) {
-    tm1638_port->OUTSET = (1<<tm1638_stbPin);
+/**
+ * @brief write all registers between lo and hi in one auto-increment burst
+ */
+static void tm1638_sendBurst(Tm1638* pBoard, uint8_t lo, uint8_t hi) {
+    tm1638_startDataFrame(pBoard, lo);
+    for (uint8_t address = lo; address <= hi; address++) {
+        tm1638_sendDataByte(pBoard->shadow[address]);
+        pBoard->dirty &= ~(1U<<address);
+    }
+    tm1638_endDataFrame(pBoard);
 }
 
 /**
- * @brief maps an uint to a 7segment pattern
+ * @brief send the dirty registers between first and last
+ * 
+ * Picks whatever needs fewer bytes on the wire:
+ * a single auto-increment burst over the dirty range
+ * or a fixed address write per dirty register.
+ * The latter needs the address mode to be switched back and forth.
  */
-uint8_t tm1638_to7Seg(uint8_t val) {
-    switch (val & 0x0F) {
-        case 0x00: return 0x3F;
-        case 0x01: return 0x06;
-        case 0x02: return 0x5B;
-        case 0x03: return 0x4F;
-        case 0x04: return 0x66;
-        case 0x05: return 0x6D;
-        case 0x06: return 0x7D;
-        case 0x07: return 0x07;
-        case 0x08: return 0x7F;
-        case 0x09: return 0x67;
-        case 0x0a: return 0x77;
-        case 0x0b: return 0x7C;
-        case 0x0c: return 0x39;
-        case 0x0d: return 0x5E;
-        case 0x0e: return 0x79;
-        case 0x0f: return 0x71;
-        default: return 0;
+static void tm1638_flushWindow(Tm1638* pBoard, uint8_t first, uint8_t last) {
+    uint8_t lo = 0;
+    uint8_t hi = 0;
+    uint8_t count = tm1638_dirtyRange(pBoard, first, last, &lo, &hi);
+    if (count == 0) {
+        return;
+    }
+
+    if (tm1638_useFixedAddress(count, lo, hi)) {
+        tm1638_sendCmd(pBoard, TM1638_CMD_FIXED_ADDRESS);
+        tm1638_sendFixed(pBoard, lo, hi);
+        tm1638_sendCmd(pBoard, TM1638_CMD_AUTO_INCREMENT);
     }
+    else {
+        tm1638_sendBurst(pBoard, lo, hi);
+    }
+}
+
+void tm1638_flush(Tm1638* pBoard) {
+    tm1638_flushWindow(pBoard, 0, TM1638_REGISTERS - 1);
 }
 
+/**
+ * @brief send a command to all boards in the bitmap at once
+ * 
+ * CLK and DIO are shared, so all selected boards clock in the same byte.
+ */
+static void tm1638_broadcastCmd(uint8_t boardMask, uint8_t cmd) {
+    for (uint8_t i=0; i < tsTm1638.boardCount; i++) {
+        if (boardMask & (1<<i)) {
+            TM1638_STB_LOW(tsTm1638.boards[i]);
+        }
+    }
+    tm1638_sendDataByte(cmd);
+    for (uint8_t i=0; i < tsTm1638.boardCount; i++) {
+        if (boardMask & (1<<i)) {
+            TM1638_STB_HIGH(tsTm1638.boards[i]);
+        }
+    }
+}
 
+void tm1638_flushAll(void) {
+    uint8_t lo = 0;
+    uint8_t hi = 0;
 
+    // boards with a burst get their data right away,
+    // the others share the address mode switches
+    uint8_t fixedBoards = 0;
+    for (uint8_t i=0; i < tsTm1638.boardCount; i++) {
+        Tm1638* pBoard = tsTm1638.boards[i];
+        uint8_t count = tm1638_dirtyRange(pBoard, 0, TM1638_REGISTERS - 1, &lo, &hi);
+        if (count == 0) {
+            continue;
+        }
+        if (tm1638_useFixedAddress(count, lo, hi)) {
+            fixedBoards |= 1<<i;
+        }
+        else {
+            tm1638_sendBurst(pBoard, lo, hi);
+        }
+    }
+
+    if (fixedBoards == 0) {
+        return;
+    }
+    tm1638_broadcastCmd(fixedBoards, TM1638_CMD_FIXED_ADDRESS);
+    for (uint8_t i=0; i < tsTm1638.boardCount; i++) {
+        if (fixedBoards & (1<<i)) {
+            tm1638_sendFixed(tsTm1638.boards[i], 0, TM1638_REGISTERS - 1);
+        }
+    }
+    tm1638_broadcastCmd(fixedBoards, TM1638_CMD_AUTO_INCREMENT);
+}
+
+/**
+ * @return true if any of the boards has changed registers
+ */
+static bool tm1638_anyDirty(void) {
+    for (uint8_t i=0; i < tsTm1638.boardCount; i++) {
+        if (tsTm1638.boards[i]->dirty != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+PT_THREAD(task_tm1638(void))
+{
+    PT_BEGIN(&tsTm1638.pt);
+
+    PT_WAIT_UNTIL(&tsTm1638.pt, tm1638_anyDirty());
+
+    // continue round robin with the next board which has changes
+    Tm1638* pBoard;
+    do {
+        if (++tsTm1638.currentBoard >= tsTm1638.boardCount) {
+            tsTm1638.currentBoard = 0;
+        }
+        pBoard = tsTm1638.boards[tsTm1638.currentBoard];
+    } while (pBoard->dirty == 0);
+
+    uint8_t first = 0;
+    while (!(pBoard->dirty & (1U<<first))) {
+        first++;
+    }
+    uint8_t last = first + TM1638_FLUSH_CHUNK - 1;
+    tm1638_flushWindow(pBoard, first, last < TM1638_REGISTERS ? last : TM1638_REGISTERS - 1);
+
+    PT_END(&tsTm1638.pt);
+}
+
+uint8_t tm1638_to7Seg(uint8_t val) {
+    return font7seg_hex(val);
+}
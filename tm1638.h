@@ -38,11 +38,57 @@
  * The 7-segment display is on even addresses, starting with 0x00.
  * 
  * The 7 LEDs are bit 0x01 on odd addresses 0x01, 0x03, etc
+ * 
+ * Multiple boards can share the CLK and DIO lines, each board
+ * just needs its own STB pin and a Tm1638 instance.
  */
 
 #include <avr/io.h>
 #include <stdbool.h>
 
+#include "pt.h"
+
+// The shared pins are fixed at compile time, so each clock edge is a single instruction.
+#ifndef TM1638_PORT
+    #define TM1638_PORT PORTA
+#endif
+#ifndef TM1638_CLK_PIN
+    #define TM1638_CLK_PIN PIN5
+#endif
+#ifndef TM1638_DIO_PIN
+    #define TM1638_DIO_PIN PIN6
+#endif
+
+// min clock low and high time, the TM1638 needs 400ns pulses and max 1MHz
+#ifndef TM1638_CLK_HALF_NS
+    #define TM1638_CLK_HALF_NS 500
+#endif
+
+// time between the falling clock edge and reading DIO
+#ifndef TM1638_READ_DELAY_US
+    #define TM1638_READ_DELAY_US 1
+#endif
+
+// Twait between the READ_KEYS command and the first read clock, min 2µs
+#ifndef TM1638_READ_WAIT_US
+    #define TM1638_READ_WAIT_US 2
+#endif
+
+// max number of registers task_tm1638 sends per call
+#ifndef TM1638_FLUSH_CHUNK
+    #define TM1638_FLUSH_CHUNK 4
+#endif
+
+// max number of boards for the batched refresh
+#ifndef TM1638_MAX_BOARDS
+    #define TM1638_MAX_BOARDS 4
+#endif
+#if TM1638_MAX_BOARDS > 8
+    #error "TM1638_MAX_BOARDS must not exceed 8"
+#endif
+
+// number of display registers
+#define TM1638_REGISTERS          16
 
 #define TM1638_CMD_READ_KEYS      0x42
 #define TM1638_CMD_AUTO_INCREMENT 0x40
@@ -58,19 +104,43 @@
 #define TM1638_CMD_SET_BRIGHTNESS 0x80
 
 /**
- * @brief initialise the tm1638 connection
+ * @brief a single TM1638 board
+ */
+typedef struct {
+    PORT_t* pStbPort;
+    uint8_t stbMask;
+
+    // what the display registers should contain
+    uint8_t shadow[TM1638_REGISTERS];
+
+    // one bit per register which still has to be sent
+    uint16_t dirty;
+} Tm1638;
+
+/**
+ * @brief set up the CLK and DIO lines shared by all boards
  * This method has to be invoked before any other tm1638 function call.
- * @param port 
- * @param stbPin Chip Select ;high -> passive, low -> chip select active
- * @param cliPin 
- * @param dioPin 
+ * 
+ * The pins are configured via TM1638_PORT, TM1638_CLK_PIN and TM1638_DIO_PIN.
+ */
+void tm1638_setup(void);
+
+/**
+ * @brief initialise a single board
+ * 
+ * The board gets cleared and added to the boards refreshed by
+ * #tm1638_flushAll and #task_tm1638.
+ * 
+ * @param pBoard the board instance
+ * @param pStbPort the port of the STB pin (Chip Select; high -> passive, low -> chip select active)
+ * @param stbPin the pin number, e.g. PIN4
  */
-void tm1638_init(volatile PORT_t* port, uint8_t stbPin, uint8_t clkPin, uint8_t dioPin);
+void tm1638_init(Tm1638* pBoard, PORT_t* pStbPort, uint8_t stbPin);
 
 /**
  * @brief Send a command
  */
-void tm1638_sendCmd(uint8_t cmd);
+void tm1638_sendCmd(Tm1638* pBoard, uint8_t cmd);
 
 /**
  * @brief Start sending display data
@@ -79,14 +149,79 @@ void tm1638_sendCmd(uint8_t cmd);
  * 
  * After all data is sent call #tm1638_endDataFrame
  * 
+ * @param pBoard the board to send to
  * @param address the starting address 
  */
-void tm1638_startDataFrame(uint8_t address);
+void tm1638_startDataFrame(Tm1638* pBoard, uint8_t address);
 void tm1638_sendDataByte(uint8_t data);
-void tm1638_endDataFrame(void);
+void tm1638_endDataFrame(Tm1638* pBoard);
+
+/**
+ * @brief set a display register
+ * 
+ * Only the register image gets changed, the data gets sent via
+ * #tm1638_flush or #task_tm1638.
+ * 
+ * @param pBoard the board
+ * @param address 0..15
+ * @param data the raw register content
+ */
+void tm1638_setRaw(Tm1638* pBoard, uint8_t address, uint8_t data);
+
+/**
+ * @brief set the segments of a 7-segment digit
+ * 
+ * @param pBoard the board
+ * @param digit 0..7, 0 is the leftmost digit
+ * @param segments the segment pattern, e.g. from #tm1638_to7Seg
+ */
+void tm1638_setDigit(Tm1638* pBoard, uint8_t digit, uint8_t segments);
+
+/**
+ * @brief switch a LED on or off
+ * 
+ * @param pBoard the board
+ * @param led 0..7, 0 is the leftmost LED
+ * @param on true to switch it on
+ */
+void tm1638_setLed(Tm1638* pBoard, uint8_t led, bool on);
+
+/**
+ * @brief send all changed registers of a board right away
+ */
+void tm1638_flush(Tm1638* pBoard);
+
+/**
+ * @brief send all changed registers of all boards in one go
+ * 
+ * The address mode switches for the fixed address writes get sent
+ * to all boards which need them at once.
+ */
+void tm1638_flushAll(void);
+
+/**
+ * @brief send changed registers in small chunks
+ * 
+ * Sends at most TM1638_FLUSH_CHUNK registers of one board per call,
+ * the boards take turns. Call it once every TASK tick.
+ */
+PT_THREAD(task_tm1638(void));
+
+/**
+ * @brief read the keys of a board
+ * 
+ * Bit 0 is the leftmost key S1, bit 7 the rightmost key S8.
+ * Takes about 40us, so it can be called every TASK tick and the result
+ * directly passed to #buttonsCheck.
+ * 
+ * @return bitmask of the pressed keys
+ */
+uint8_t tm1638_readKeys(Tm1638* pBoard);
 
 /**
  * @brief map a numeric value from 0..F to it's 7-segment pattern
+ * 
+ * See gfx/font_7seg.h for text and number rendering.
  */
 uint8_t tm1638_to7Seg(uint8_t val);
 